@@ -0,0 +1,170 @@
+#include "pch.h"
+
+#include "BitExpand.h"
+
+#include <intrin.h>
+
+// The SIMD versions are compiled for their instruction set one function
+// at a time, everything else for the baseline, so the scalar version and
+// the cpuid dispatch run on any x64 CPU. MSVC compiles its intrinsics
+// anywhere, gcc and clang need the target per function.
+#if defined(_MSC_VER)
+#define TARGET_SSE41
+#define TARGET_AVX2
+#else
+#define TARGET_SSE41    __attribute__((target("sse4.1")))
+#define TARGET_AVX2     __attribute__((target("avx2")))
+#endif
+
+namespace scene
+{
+
+// Per byte value: its set bit positions packed into bytes, ascending,
+// and how many there are.
+struct ByteTable
+{
+    uint64_t    positions[256];
+    uint8_t     count[256];
+
+    ByteTable()
+    {
+        for (int v = 0; v < 256; ++v)
+        {
+            uint64_t    p = 0;
+            int         n = 0;
+            for (int i = 0; i < 8; ++i)
+            {
+                if ((v >> i) & 1)
+                    p |= static_cast<uint64_t>(i) << (8 * n++);
+            }
+            positions[v]    = p;
+            count[v]        = static_cast<uint8_t>(n);
+        }
+    }
+};
+static const ByteTable gByteTable;
+
+// Few bits: a step per bit beats a step per byte.
+enum { SPARSE_BITS = 8 };
+
+static size_t ExpandSparseBits(uint64_t bits, uint32_t base, uint32_t * pOut)
+{
+    uint32_t * p = pOut;
+    for (; bits != 0; bits &= bits - 1)
+        *p++ = base + CountTrailingZeros(bits);
+    return static_cast<size_t>(p - pOut);
+}
+
+static size_t ExpandBitsScalar(uint64_t bits, uint32_t base, uint32_t * pOut)
+{
+    if (PopCount(bits) <= SPARSE_BITS)
+        return ExpandSparseBits(bits, base, pOut);
+
+    uint32_t * p = pOut;
+    for (; bits != 0; bits >>= 8, base += 8)
+    {
+        uint32_t v = bits & 0xff;
+        if (v == 0)
+            continue;
+
+        // store all 8, keep count
+        uint64_t positions = gByteTable.positions[v];
+        for (int k = 0; k < 8; ++k, positions >>= 8)
+            p[k] = base + static_cast<uint32_t>(positions & 0xff);
+        p += gByteTable.count[v];
+    }
+    return static_cast<size_t>(p - pOut);
+}
+
+// 4 positions a step: widen 4 packed bytes, add base, store.
+TARGET_SSE41
+static size_t ExpandBitsSse41(uint64_t bits, uint32_t base, uint32_t * pOut)
+{
+    if (PopCount(bits) <= SPARSE_BITS)
+        return ExpandSparseBits(bits, base, pOut);
+
+    uint32_t *  p       = pOut;
+    __m128i     vbase   = _mm_set1_epi32(static_cast<int>(base));
+    const __m128i FOUR  = _mm_set1_epi32(4);
+
+    for (; bits != 0; bits >>= 4, vbase = _mm_add_epi32(vbase, FOUR))
+    {
+        uint32_t v = bits & 0xf;
+        if (v == 0)
+            continue;
+
+        __m128i idx = _mm_cvtsi32_si128(static_cast<int>(gByteTable.positions[v]));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(p),
+                         _mm_add_epi32(_mm_cvtepu8_epi32(idx), vbase));
+        p += gByteTable.count[v];
+    }
+    return static_cast<size_t>(p - pOut);
+}
+
+// 8 positions a step: widen 8 packed bytes, add base, store.
+TARGET_AVX2
+static size_t ExpandBitsAvx2(uint64_t bits, uint32_t base, uint32_t * pOut)
+{
+    if (PopCount(bits) <= SPARSE_BITS)
+        return ExpandSparseBits(bits, base, pOut);
+
+    uint32_t *  p       = pOut;
+    __m256i     vbase   = _mm256_set1_epi32(static_cast<int>(base));
+    const __m256i EIGHT = _mm256_set1_epi32(8);
+
+    for (; bits != 0; bits >>= 8, vbase = _mm256_add_epi32(vbase, EIGHT))
+    {
+        uint32_t v = bits & 0xff;
+        if (v == 0)
+            continue;
+
+        __m128i idx = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(&gByteTable.positions[v]));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(p),
+                            _mm256_add_epi32(_mm256_cvtepu8_epi32(idx), vbase));
+        p += gByteTable.count[v];
+    }
+    return static_cast<size_t>(p - pOut);
+}
+
+static bool HasSse41()
+{
+    int r[4];
+    __cpuid(r, 1);
+    return (r[2] >> 19) & 1;
+}
+
+static bool HasAvx2()
+{
+    int r[4];
+    __cpuid(r, 0);
+    if (r[0] < 7)
+        return false;
+
+    // AVX enabled by the OS: OSXSAVE, AVX, and XMM/YMM state saved
+    __cpuid(r, 1);
+    if (!((r[2] >> 27) & 1) || !((r[2] >> 28) & 1) || (_xgetbv(0) & 6) != 6)
+        return false;
+
+    __cpuidex(r, 7, 0);
+    return (r[1] >> 5) & 1;
+}
+
+static ExpandBitsIsa PickIsa()
+{
+    return HasAvx2() ? EXPAND_AVX2 : HasSse41() ? EXPAND_SSE41 : EXPAND_SCALAR;
+}
+
+ExpandBitsFunc GetExpandBits(ExpandBitsIsa isa)
+{
+    switch (isa)
+    {
+        case EXPAND_AVX2:   return HasAvx2() ? ExpandBitsAvx2 : nullptr;
+        case EXPAND_SSE41:  return HasSse41() ? ExpandBitsSse41 : nullptr;
+        default:            return ExpandBitsScalar;
+    }
+}
+
+const ExpandBitsIsa     ExpandBitsBestIsa   = PickIsa();
+const ExpandBitsFunc    ExpandBits          = GetExpandBits(ExpandBitsBestIsa);
+
+}
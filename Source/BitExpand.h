@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace scene
+{
+    // Compress-store of bit positions, the inner loop of meshing.
+    // Write base + i for each set bit i of 'bits', ascending, return how
+    // many. pOut needs room for 64 values, the SIMD versions store whole
+    // vectors past the last one.
+    typedef size_t (*ExpandBitsFunc)(uint64_t bits, uint32_t base, uint32_t * pOut);
+
+    enum ExpandBitsIsa
+    {
+        EXPAND_SCALAR,
+        EXPAND_SSE41,
+        EXPAND_AVX2,
+    };
+
+    // The best version this CPU runs, picked at startup.
+    extern const ExpandBitsFunc     ExpandBits;
+    extern const ExpandBitsIsa      ExpandBitsBestIsa;
+
+    // A given version, nullptr if this CPU can't run it.
+    ExpandBitsFunc                  GetExpandBits(ExpandBitsIsa isa);
+
+    // __popcnt64 is x64 only and needs SSE4.2, count in registers instead.
+    inline int PopCount(uint64_t bits)
+    {
+        bits = bits - ((bits >> 1) & 0x5555555555555555ull);
+        bits = (bits & 0x3333333333333333ull) + ((bits >> 2) & 0x3333333333333333ull);
+        bits = (bits + (bits >> 4)) & 0x0f0f0f0f0f0f0f0full;
+        return static_cast<int>((bits * 0x0101010101010101ull) >> 56);
+    }
+    // 64 if bits is 0.
+    inline int CountTrailingZeros(uint64_t bits)
+    {
+        return PopCount((bits & (0 - bits)) - 1);
+    }
+}
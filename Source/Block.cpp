@@ -2,16 +2,28 @@
 
 #include "Block.h"
 #include "CubeRenderer.h"
+#include "ChunkMap.h"
+#include "BlockStorage.h"
+#include "BlockOctree.h"
+#include "BlockLayout.h"
+#include "BitExpand.h"
+#include "ChunkGeometry.h"
+#include "LockFreeQueue.h"
+#include "ResidencyManager.h"
+#include "SlabPool.h"
+#include "WorkerPool.h"
 
-#include <array>
+#include <atomic>
+#include <climits>
+#include <cmath>
+#include <emmintrin.h>
+#include <exception>
 #include <vector>
-#include <map>
 #include <sstream>
 
 namespace scene
 {
 
-typedef std::vector<BlockType>          TypeCube;
 typedef struct Int2 { int _0, _1; }     Int2;
 
 struct Cube
@@ -25,283 +37,2429 @@ struct Cube
         zz._0 = std::max(c.zz._0, zz._0); zz._1 = std::min(c.zz._1, zz._1);
     }
 
+    void Translate(int dx, int dy, int dz)
+    {
+        xx._0 += dx; xx._1 += dx;
+        yy._0 += dy; yy._1 += dy;
+        zz._0 += dz; zz._1 += dz;
+    }
+
     int Volumn() const
     {
         return (xx._1 - xx._0) * (yy._1 - yy._0) * (zz._1 - zz._0);
     }
 
-};
+};
+
+// Face neighbour directions, the opposite of face f is f ^ 1.
+enum Face
+{
+    NEG_X, POS_X, NEG_Y, POS_Y, NEG_Z, POS_Z,
+    FACE_COUNT,
+};
+static const int FACE_NORMAL[FACE_COUNT][3] =
+{
+    { -1, 0, 0 }, { 1, 0, 0 },
+    { 0, -1, 0 }, { 0, 1, 0 },
+    { 0, 0, -1 }, { 0, 0, 1 },
+};
+
+// 1. memory repr
+// 2. sync to GPU instance buffer
+template <typename TGeometry, template <int> class TLayout = LinearLayoutT>
+struct BlockCubeT
+{
+    enum { L = TGeometry::LENGTH };
+
+    typedef TGeometry                   Geometry;
+    typedef PaletteStorageT<L * L * L>  FlatStorage;
+    typedef OctreeStorageT<L>           SparseStorage;
+    typedef TLayout<L>                  Layout;
+
+    // Octree replaces the flat storage when it is estimated to be smaller:
+    // an isolated block costs about one 8-node group per octree level.
+    enum { SPARSE_BYTES_PER_BLOCK = 8 * sizeof(uint32_t) * (L <= 16 ? 4 : L <= 32 ? 5 : 6) };
+
+    enum
+    {
+        SECTION         = TGeometry::SECTION_LENGTH,
+        SECTION_AXIS    = TGeometry::SECTION_AXIS,
+        SECTION_COUNT   = TGeometry::SECTION_COUNT,
+
+        // 4^3 cells of the occupancy summary
+        CELL            = 4,
+        CELL_AXIS       = L / CELL,
+    };
+    static_assert(SECTION_COUNT <= 64, "dirty mask is 64 bits");
+
+    typedef std::vector<uint64_t, ChunkAllocatorT<uint64_t>> RowArray;
+
+    FlatStorage                     typeInfo;
+    std::unique_ptr<SparseStorage>  sparseInfo; // not null: typeInfo unused
+    uint64_t                        dirtySections; // bit per section changed since BeginMesh
+
+    // Occupancy rows are built by the edit that gives a flat chunk more
+    // than one type, meshed or not, see KeepRows, and kept by edits.
+    // BeginMesh drops them once a chunk turns uniform or octree, those
+    // answer from storage, see HasRows.
+    // bit lx of row (ly, lz) set if the block is not empty
+    RowArray                        occupancy;
+    // coarser levels of occupancy for empty-space skipping, bit set if
+    // any block inside is solid: 4^3 cells, bit cx of row (cy, cz),
+    // and 16^3 sections, bit SectionBit
+    RowArray                        occupancy4;
+    uint64_t                        occupancy16;
+    // per face, sections of that neighbour bordering changed blocks,
+    // forwarded by BlockSystemImpl
+    uint64_t                        neighbourDirty[FACE_COUNT];
+
+    BlockMeshMode                   meshMode;
+    uint32_t                        meshEpoch;  // bumped when the mesh is dropped
+
+    // INSTANCE_MESH
+    // instance per exposed block as of the last EndMesh, keyed by (lz * L + ly) * L + lx
+    render::PooledCubeRenderer::InstanceSlotMap     instances;
+    // bit lx of row (ly, lz) set if the block has an instance, lent to
+    // MeshTask. Kept along with the occupancy rows only.
+    RowArray                        instanceRows;
+
+    // FACE_MESH, GREEDY_MESH
+    // 4 vertices per quad as of the last EndMesh
+    std::vector<render::PooledCubeRenderer::FaceVertex> faceVertices;
+
+    BlockCubeT(BlockMeshMode mode = INSTANCE_MESH)
+        : dirtySections(0)
+        , occupancy16(0)
+        , neighbourDirty()
+        , meshMode(mode)
+        , meshEpoch(0)
+    {}
+
+    // chunks churn as the world streams, keep them off the heap
+    static void * operator new(size_t n) { return ChunkMemory::Alloc(n); }
+    static void operator delete(void * p, size_t n) { ChunkMemory::Free(p, n); }
+
+    static int Index(int lx, int ly, int lz)
+    {
+        return Layout::Encode(lx, ly, lz);
+    }
+    static uint64_t SectionBit(int lx, int ly, int lz)
+    {
+        return 1ull << TGeometry::Section(lx, ly, lz);
+    }
+    // sections touched by inclusive local box
+    static uint64_t SectionMask(Int2 lxx, Int2 lyy, Int2 lzz)
+    {
+        uint64_t mask = 0;
+        for (int lz = lzz._0 & ~(SECTION - 1); lz <= lzz._1; lz += SECTION)
+        for (int ly = lyy._0 & ~(SECTION - 1); ly <= lyy._1; ly += SECTION)
+        for (int lx = lxx._0 & ~(SECTION - 1); lx <= lxx._1; lx += SECTION)
+        {
+            mask |= SectionBit(lx, ly, lz);
+        }
+        return mask;
+    }
+
+    bool IsDirty() const
+    {
+        return dirtySections != 0;
+    }
+    // Drop the current mesh, the next Sync builds one in the new mode.
+    void SetMeshMode(BlockMeshMode mode)
+    {
+        if (mode == meshMode)
+            return;
+
+        meshMode = mode;
+        ++meshEpoch;
+
+        instances.Clear();
+        std::vector<render::PooledCubeRenderer::FaceVertex>().swap(faceVertices);
+        RowArray().swap(instanceRows);
+
+        dirtySections = ~0ull >> (64 - SECTION_COUNT);
+    }
+    // Bytes the current mesh takes on the GPU.
+    size_t GetMeshBytes() const
+    {
+        return meshMode == INSTANCE_MESH ?
+            instances.Size() * sizeof(render::PooledCubeRenderer::CubeInstance) :
+            faceVertices.size() * sizeof(render::PooledCubeRenderer::FaceVertex);
+    }
+    size_t GetMeshTriangles() const
+    {
+        return meshMode == INSTANCE_MESH ?
+            instances.Size() * 12 :
+            faceVertices.size() / 2;
+    }
+
+    BlockType Get(int lx, int ly, int lz) const
+    {
+        return sparseInfo ?
+            sparseInfo->Get(lx, ly, lz) :
+            typeInfo.Get(Index(lx, ly, lz));
+    }
+    // Return type of the homogeneous aligned cube containing (lx, ly, lz),
+    // and its size, for empty-space skipping.
+    BlockType Find(int lx, int ly, int lz, int * pSize) const
+    {
+        if (sparseInfo)
+            return sparseInfo->Find(lx, ly, lz, pSize);
+
+        *pSize = typeInfo.IsUniform() ? L : 1;
+        return typeInfo.Get(Index(lx, ly, lz));
+    }
+    void Set(int lx, int ly, int lz, BlockType t)
+    {
+        BlockType t0 = sparseInfo ?
+            sparseInfo->Set(lx, ly, lz, t) :
+            typeInfo.Set(Index(lx, ly, lz), t);
+        if (t0 != t)
+        {
+            dirtySections |= SectionBit(lx, ly, lz);
+            Retype(lx, ly, lz, t);
+            if ((t0 == EMPTY_BLOCK) != (t == EMPTY_BLOCK))
+                FlipOccupancy(lx, ly, lz);
+            KeepRows();
+        }
+    }
+    // Set block at storage index i. The caller marks its section dirty,
+    // sections it exposes are marked here. Return previous type.
+    BlockType Put(int i, BlockType t)
+    {
+        int lx, ly, lz;
+        Layout::Decode(i, &lx, &ly, &lz);
+
+        BlockType t0 = sparseInfo ?
+            sparseInfo->Set(lx, ly, lz, t) :
+            typeInfo.Set(i, t);
+        if (t0 != t)
+            Retype(lx, ly, lz, t);
+        if ((t0 == EMPTY_BLOCK) != (t == EMPTY_BLOCK))
+            FlipOccupancy(lx, ly, lz);
+        if (t0 != t)
+            KeepRows();
+        return t0;
+    }
+    // inclusive local box
+    void Set(Int2 lxx, Int2 lyy, Int2 lzz, BlockType t)
+    {
+        bool fullX = lxx._0 == 0 && lxx._1 == L - 1;
+        bool fullY = lyy._0 == 0 && lyy._1 == L - 1;
+        bool fullZ = lzz._0 == 0 && lzz._1 == L - 1;
+
+        if (fullX && fullY && fullZ)
+        {
+            // whole chunk becomes uniform
+            sparseInfo.reset();
+            typeInfo = FlatStorage(t);
+        }
+        else if (sparseInfo)
+        {
+            sparseInfo->Fill(lxx._0, lyy._0, lzz._0, lxx._1, lyy._1, lzz._1, t);
+        }
+        else if (!Layout::ROW_CONTIGUOUS)
+        {
+            FillCubes(0, 0, 0, L, lxx, lyy, lzz, t);
+        }
+        else if (fullX && fullY)
+        {
+            typeInfo.Fill(lzz._0 * L * L, (lzz._1 + 1) * L * L, t);
+        }
+        else if (fullX)
+        {
+            // one run of full rows per slice
+            for (int lz = lzz._0; lz <= lzz._1; ++lz)
+            {
+                typeInfo.Fill(Index(0, lyy._0, lz), Index(0, lyy._1, lz) + L, t);
+            }
+        }
+        else
+        {
+            for (int lz = lzz._0; lz <= lzz._1; ++lz)
+            for (int ly = lyy._0; ly <= lyy._1; ++ly)
+            {
+                typeInfo.Fill(Index(lxx._0, ly, lz), Index(lxx._1, ly, lz) + 1, t);
+            }
+        }
+        if (HasRows())
+        {
+            uint64_t bits = (~0ull >> (63 - lxx._1)) & ~((1ull << lxx._0) - 1);
+            for (int lz = lzz._0; lz <= lzz._1; ++lz)
+            for (int ly = lyy._0; ly <= lyy._1; ++ly)
+            {
+                uint64_t & row = occupancy[lz * L + ly];
+                row = t == EMPTY_BLOCK ? row & ~bits : row | bits;
+            }
+            if (t == EMPTY_BLOCK)
+                UpdateOccupancySummary(lxx, lyy, lzz);
+            else
+                FillOccupancySummary(lxx, lyy, lzz);
+        }
+        // instances of the box stay until the next mesh, retype them: a
+        // block cleared since then may have an instance too, see Retype
+        if (t != EMPTY_BLOCK && instances.Size() != 0)
+            RetypeInstances(lxx, lyy, lzz, t);
+
+        dirtySections |= ExposureMask(lxx, lyy, lzz);
+        MarkNeighbours(lxx, lyy, lzz);
+        KeepRows();
+    }
+    // Block changed to t, may be empty.
+    void Retype(int lx, int ly, int lz, BlockType t)
+    {
+        // Meshing keeps an instance that is still exposed, it won't see a
+        // new type. Empty to solid counts too: a block cleared since the
+        // last mesh still has its instance.
+        if (t != EMPTY_BLOCK)
+        {
+            uint32_t key = static_cast<uint32_t>((lz * L + ly) * L + lx);
+            if (instances.Find(key))
+                instances.Set(key, render::PooledCubeRenderer::PackCubeInstance(lx, ly, lz, t));
+        }
+    }
+    // Retype the instances inside the inclusive box to solid t.
+    void RetypeInstances(Int2 lxx, Int2 lyy, Int2 lzz, BlockType t)
+    {
+        for (size_t i = 0; i < instances.Size(); ++i)
+        {
+            int lx, ly, lz, t0;
+            render::PooledCubeRenderer::UnpackCubeInstance(instances.Data()[i], &lx, &ly, &lz, &t0);
+            if (lx < lxx._0 || lx > lxx._1 ||
+                ly < lyy._0 || ly > lyy._1 ||
+                lz < lzz._0 || lz > lzz._1 ||
+                static_cast<BlockType>(t0) == t)
+                continue;
+
+            // rewrites slot i in place
+            instances.Set(static_cast<uint32_t>((lz * L + ly) * L + lx),
+                          render::PooledCubeRenderer::PackCubeInstance(lx, ly, lz, t));
+        }
+    }
+    // Block became empty or solid.
+    void FlipOccupancy(int lx, int ly, int lz)
+    {
+        if (HasRows())
+        {
+            occupancy[lz * L + ly] ^= 1ull << lx;
+            if ((occupancy[lz * L + ly] >> lx) & 1)
+                FillOccupancySummary({ lx, lx }, { ly, ly }, { lz, lz });
+            else
+                UpdateOccupancySummary({ lx, lx }, { ly, ly }, { lz, lz });
+        }
+
+        // neighbours inside the same section: skip the box math
+        const int M = SECTION - 1;
+        if (((lx + 1) & M) > 1 && ((ly + 1) & M) > 1 && ((lz + 1) & M) > 1)
+        {
+            dirtySections |= SectionBit(lx, ly, lz);
+            return;
+        }
+        dirtySections |= ExposureMask({ lx, lx }, { ly, ly }, { lz, lz });
+        MarkNeighbours({ lx, lx }, { ly, ly }, { lz, lz });
+    }
+    // Inclusive box became solid.
+    void FillOccupancySummary(Int2 lxx, Int2 lyy, Int2 lzz)
+    {
+        uint64_t cells = (~0ull >> (63 - (lxx._1 >> 2))) & ~((1ull << (lxx._0 >> 2)) - 1);
+        for (int cz = lzz._0 >> 2; cz <= lzz._1 >> 2; ++cz)
+        for (int cy = lyy._0 >> 2; cy <= lyy._1 >> 2; ++cy)
+        {
+            occupancy4[cz * CELL_AXIS + cy] |= cells;
+        }
+        occupancy16 |= SectionMask(lxx, lyy, lzz);
+    }
+    // Inclusive box became empty, recount the summary cells over it.
+    void UpdateOccupancySummary(Int2 lxx, Int2 lyy, Int2 lzz)
+    {
+        for (int cz = lzz._0 >> 2; cz <= lzz._1 >> 2; ++cz)
+        for (int cy = lyy._0 >> 2; cy <= lyy._1 >> 2; ++cy)
+        {
+            // rows of the 4 x 4 column of cells, then 4 bits per cell
+            uint64_t any = 0;
+            for (int lz = cz * CELL; lz < cz * CELL + CELL; ++lz)
+            for (int ly = cy * CELL; ly < cy * CELL + CELL; ++ly)
+            {
+                any |= occupancy[lz * L + ly];
+            }
+            uint64_t cells = 0;
+            for (int cx = 0; any != 0; ++cx, any >>= CELL)
+            {
+                if (any & 0xf)
+                    cells |= 1ull << cx;
+            }
+            occupancy4[cz * CELL_AXIS + cy] = cells;
+        }
+
+        const int M = SECTION / CELL;   // cells per section edge
+        for (int sz = lzz._0 / SECTION; sz <= lzz._1 / SECTION; ++sz)
+        for (int sy = lyy._0 / SECTION; sy <= lyy._1 / SECTION; ++sy)
+        for (int sx = lxx._0 / SECTION; sx <= lxx._1 / SECTION; ++sx)
+        {
+            uint64_t any = 0;
+            for (int cz = sz * M; cz < sz * M + M; ++cz)
+            for (int cy = sy * M; cy < sy * M + M; ++cy)
+            {
+                any |= occupancy4[cz * CELL_AXIS + cy];
+            }
+            uint64_t bit = SectionBit(sx * SECTION, sy * SECTION, sz * SECTION);
+            if ((any >> (sx * M)) & ((1ull << M) - 1))
+                occupancy16 |= bit;
+            else
+                occupancy16 &= ~bit;
+        }
+    }
+    // 0 if the block is solid, else the edge of the empty aligned cube
+    // holding it: a section, a 4^3 cell or the block from the rows,
+    // the chunk if uniform, an octree leaf.
+    int EmptySize(int lx, int ly, int lz) const
+    {
+        if (!HasRows())
+        {
+            int         size;
+            BlockType   t = Find(lx, ly, lz, &size);
+            return t == EMPTY_BLOCK ? size : 0;
+        }
+        if (!(occupancy16 & SectionBit(lx, ly, lz)))
+            return SECTION;
+        if (!((occupancy4[(lz >> 2) * CELL_AXIS + (ly >> 2)] >> (lx >> 2)) & 1))
+            return CELL;
+        return ((occupancy[lz * L + ly] >> lx) & 1) ? 0 : 1;
+    }
+    // Any solid block in the inclusive box: a word test per row, one
+    // test for a uniform chunk.
+    bool AnySolid(Int2 lxx, Int2 lyy, Int2 lzz) const
+    {
+        if (!HasRows())
+        {
+            if (!sparseInfo && typeInfo.IsUniform())
+                return typeInfo.Get(0) != EMPTY_BLOCK;
+
+            uint64_t any = 0;
+            VisitOccupancy(lxx, lyy, lzz, [&any] (int, int, uint64_t bits) { any |= bits; });
+            return any != 0;
+        }
+
+        uint64_t bits = (~0ull >> (63 - lxx._1)) & ~((1ull << lxx._0) - 1);
+        for (int lz = lzz._0; lz <= lzz._1; ++lz)
+        for (int ly = lyy._0; ly <= lyy._1; ++ly)
+        {
+            if (occupancy[lz * L + ly] & bits)
+                return true;
+        }
+        return false;
+    }
+    bool HasRows() const
+    {
+        return !occupancy.empty();
+    }
+    // After an edit: a flat chunk that got a second type builds its rows,
+    // rays and Move skip empty space with them whether meshed or not.
+    void KeepRows()
+    {
+        if (!sparseInfo && !HasRows() && !typeInfo.IsUniform())
+            BuildRows();
+    }
+    // Occupancy rows and summary levels from storage.
+    void BuildRows()
+    {
+        RowArray rows;
+        GetOccupancy(&rows);
+        occupancy.swap(rows);
+        occupancy4.assign(CELL_AXIS * CELL_AXIS, 0);
+        occupancy16 = 0;
+        UpdateOccupancySummary({ 0, L - 1 }, { 0, L - 1 }, { 0, L - 1 });
+    }
+    void ReleaseRows()
+    {
+        RowArray().swap(occupancy);
+        RowArray().swap(occupancy4);
+        RowArray().swap(instanceRows);
+        occupancy16 = 0;
+    }
+    // Occupancy of the whole chunk, L * L rows.
+    void GetOccupancy(RowArray * pRows) const
+    {
+        if (HasRows())
+        {
+            *pRows = occupancy;
+            return;
+        }
+
+        pRows->assign(L * L, 0);
+        if (sparseInfo)
+        {
+            // solid leaves only
+            sparseInfo->ForEachLeaf(
+                [pRows] (int x, int y, int z, int size, BlockType t)
+                {
+                    if (t == EMPTY_BLOCK)
+                        return;
+
+                    uint64_t bits = (~0ull >> (64 - size)) << x;
+                    for (int lz = z; lz < z + size; ++lz)
+                    for (int ly = y; ly < y + size; ++ly)
+                    {
+                        (*pRows)[lz * L + ly] |= bits;
+                    }
+                });
+            return;
+        }
+        VisitOccupancy({ 0, L - 1 }, { 0, L - 1 }, { 0, L - 1 },
+                       [pRows] (int ly, int lz, uint64_t bits) { (*pRows)[lz * L + ly] = bits; });
+    }
+    // Visit the inclusive box as rows along x: f(ly, lz, bits), bit lx set
+    // if the block is solid, no bits outside the box.
+    template <typename F>
+    void VisitOccupancy(Int2 lxx, Int2 lyy, Int2 lzz, F && f) const
+    {
+        if (HasRows())
+        {
+            uint64_t bits = (~0ull >> (63 - lxx._1)) & ~((1ull << lxx._0) - 1);
+            for (int lz = lzz._0; lz <= lzz._1; ++lz)
+            for (int ly = lyy._0; ly <= lyy._1; ++ly)
+            {
+                f(ly, lz, occupancy[lz * L + ly] & bits);
+            }
+            return;
+        }
+        if (!sparseInfo && Layout::ROW_CONTIGUOUS)
+        {
+            // solid bits straight from the packed indices
+            int         count   = lxx._1 - lxx._0 + 1;
+            uint64_t    all     = ~0ull >> (64 - count);
+            for (int lz = lzz._0; lz <= lzz._1; ++lz)
+            for (int ly = lyy._0; ly <= lyy._1; ++ly)
+            {
+                f(ly, lz, (~typeInfo.Match(Index(lxx._0, ly, lz), count, EMPTY_BLOCK) & all) << lxx._0);
+            }
+            return;
+        }
+        VisitRows(lxx, lyy, lzz,
+                  [&f] (int lx, int ly, int lz, int count, const BlockType * types, BlockType t)
+                  {
+                      uint64_t bits = 0;
+                      if (!types)
+                      {
+                          if (t != EMPTY_BLOCK)
+                              bits = (~0ull >> (64 - count)) << lx;
+                      }
+                      else
+                      {
+                          for (int i = 0; i < count; ++i)
+                              bits |= static_cast<uint64_t>(types[i] != EMPTY_BLOCK) << (lx + i);
+                      }
+                      f(ly, lz, bits);
+                  });
+    }
+    // sections whose exposure depends on the inclusive box: the box and
+    // the blocks next to it
+    static uint64_t ExposureMask(Int2 lxx, Int2 lyy, Int2 lzz)
+    {
+        return SectionMask({ std::max(lxx._0 - 1, 0), std::min(lxx._1 + 1, L - 1) },
+                           { std::max(lyy._0 - 1, 0), std::min(lyy._1 + 1, L - 1) },
+                           { std::max(lzz._0 - 1, 0), std::min(lzz._1 + 1, L - 1) });
+    }
+    // Exposure of neighbour blocks facing the inclusive box may have changed.
+    void MarkNeighbours(Int2 lxx, Int2 lyy, Int2 lzz)
+    {
+        const Int2 LO = { 0, 0 };
+        const Int2 HI = { L - 1, L - 1 };
+
+        if (lxx._0 == 0)        neighbourDirty[NEG_X] |= SectionMask(HI, lyy, lzz);
+        if (lxx._1 == L - 1)    neighbourDirty[POS_X] |= SectionMask(LO, lyy, lzz);
+        if (lyy._0 == 0)        neighbourDirty[NEG_Y] |= SectionMask(lxx, HI, lzz);
+        if (lyy._1 == L - 1)    neighbourDirty[POS_Y] |= SectionMask(lxx, LO, lzz);
+        if (lzz._0 == 0)        neighbourDirty[NEG_Z] |= SectionMask(lxx, lyy, HI);
+        if (lzz._1 == L - 1)    neighbourDirty[POS_Z] |= SectionMask(lxx, lyy, LO);
+    }
+    // Fill the aligned cubes of size 'size' at (x, y, z) inside the box,
+    // for layouts where such a cube is one index range.
+    void FillCubes(int x, int y, int z, int size, Int2 lxx, Int2 lyy, Int2 lzz, BlockType t)
+    {
+        if (x > lxx._1 || x + size - 1 < lxx._0 ||
+            y > lyy._1 || y + size - 1 < lyy._0 ||
+            z > lzz._1 || z + size - 1 < lzz._0)
+            return;
+
+        if (lxx._0 <= x && x + size - 1 <= lxx._1 &&
+            lyy._0 <= y && y + size - 1 <= lyy._1 &&
+            lzz._0 <= z && z + size - 1 <= lzz._1)
+        {
+            int i = Index(x, y, z);
+            typeInfo.Fill(i, i + size * size * size, t);
+            return;
+        }
+
+        int h = size >> 1;
+        for (int o = 0; o < 8; ++o)
+        {
+            FillCubes(x + ((o & 1) ? h : 0),
+                      y + ((o & 2) ? h : 0),
+                      z + ((o & 4) ? h : 0),
+                      h, lxx, lyy, lzz, t);
+        }
+    }
+    int Length() const
+    {
+        return L;
+    }
+    // Visit inclusive local box as rows along x, in storage order:
+    // f(lx, ly, lz, count, types, type), types is nullptr if the row is all 'type'.
+    template <typename F>
+    void VisitRows(Int2 lxx, Int2 lyy, Int2 lzz, F && f) const
+    {
+        VisitRows(typeInfo, sparseInfo.get(), lxx, lyy, lzz, f);
+    }
+    // The same over storage that is not the chunk's, see MeshTask.
+    template <typename F>
+    static void VisitRows(const FlatStorage & flat, const SparseStorage * pSparse,
+                          Int2 lxx, Int2 lyy, Int2 lzz, F && f)
+    {
+        BlockType   row[L];
+        int         count = lxx._1 - lxx._0 + 1;
+
+        for (int lz = lzz._0; lz <= lzz._1; ++lz)
+        for (int ly = lyy._0; ly <= lyy._1; ++ly)
+        {
+            if (pSparse)
+            {
+                int         size;
+                BlockType   t = pSparse->Find(lxx._0, ly, lz, &size);
+                int         end = (lxx._0 & ~(size - 1)) + size - 1;
+
+                if (end >= lxx._1)
+                {
+                    f(lxx._0, ly, lz, count, nullptr, t);
+                    continue;
+                }
+                for (int lx = lxx._0; lx <= lxx._1; lx = end + 1)
+                {
+                    t = pSparse->Find(lx, ly, lz, &size);
+                    end = std::min((lx & ~(size - 1)) + size - 1, lxx._1);
+                    std::fill(row + lx - lxx._0, row + end + 1 - lxx._0, t);
+                }
+                f(lxx._0, ly, lz, count, row, t);
+            }
+            else if (flat.IsUniform())
+            {
+                f(lxx._0, ly, lz, count, nullptr, flat.Get(0));
+            }
+            else if (Layout::ROW_CONTIGUOUS)
+            {
+                flat.Decode(Index(lxx._0, ly, lz), Index(lxx._1, ly, lz) + 1, row);
+                f(lxx._0, ly, lz, count, row, row[0]);
+            }
+            else
+            {
+                for (int lx = lxx._0; lx <= lxx._1; ++lx)
+                {
+                    row[lx - lxx._0] = flat.Get(Index(lx, ly, lz));
+                }
+                f(lxx._0, ly, lz, count, row, row[0]);
+            }
+        }
+    }
+    // From the palette's use counts, kept by edits. Octree chunks count
+    // their leaves.
+    size_t Count(BlockType t) const
+    {
+        return sparseInfo ? sparseInfo->Count(t) : typeInfo.Count(t);
+    }
+    size_t GetMemoryUsage() const
+    {
+        return sparseInfo ? sparseInfo->GetMemoryUsage() : typeInfo.GetMemoryUsage();
+    }
+
+    // Pick flat or sparse storage by density, with hysteresis.
+    void Rebalance()
+    {
+        if (!sparseInfo)
+        {
+            if (typeInfo.IsUniform())
+                return;
+
+            size_t nSolid = L * L * L - Count(BlockType::EMPTY_BLOCK);
+            if (nSolid * SPARSE_BYTES_PER_BLOCK >= typeInfo.GetMemoryUsage() / 2)
+                return;
+
+            sparseInfo.reset(new SparseStorage);
+
+            for (int i = 0; i < L * L * L; ++i)
+            {
+                BlockType t = typeInfo.Get(i);
+                if (t != BlockType::EMPTY_BLOCK)
+                {
+                    int lx, ly, lz;
+                    Layout::Decode(i, &lx, &ly, &lz);
+                    sparseInfo->Set(lx, ly, lz, t);
+                }
+            }
+            typeInfo = FlatStorage();
+        }
+        else
+        {
+            // smallest flat storage is 1 bit per block
+            if (sparseInfo->GetMemoryUsage() <= L * L * L / 8)
+                return;
+
+            sparseInfo->ForEachLeaf(
+                [this] (int x, int y, int z, int size, BlockType t)
+                {
+                    if (t == BlockType::EMPTY_BLOCK)
+                        return;
+
+                    for (int lz = z; lz < z + size; ++lz)
+                    for (int ly = y; ly < y + size; ++ly)
+                    for (int lx = x; lx < x + size; ++lx)
+                    {
+                        typeInfo.Set(Index(lx, ly, lz), t);
+                    }
+                });
+            sparseInfo.reset();
+        }
+    }
+
+    // Dirty sections of one chunk, meshed on a worker: a copy of the
+    // occupancy and neighbour border planes, with the instance rows or a
+    // copy of the storage.
+    struct MeshTask
+    {
+        RowArray                        occupancy;
+        // FACE_MESH, GREEDY_MESH only, the worker splits it by type
+        FlatStorage                     typeInfo;
+        std::unique_ptr<SparseStorage>  sparseInfo;
+        // per face, the neighbour's touching plane, all 0 if not loaded:
+        // X: bit ly of [lz], Y: row of [lz], Z: row of [ly]
+        uint64_t                        border[FACE_COUNT][L];
+        uint64_t                        sections;
+        BlockMeshMode                   mode;
+        uint32_t                        epoch;
+        RowArray                        instanceRows;   // INSTANCE_MESH only
+        int                             bx, by, bz;
+
+        // output, INSTANCE_MESH: keys of instances to add and remove
+        std::vector<uint32_t>           added;
+        std::vector<uint32_t>           removed;
+        // output, FACE_MESH and GREEDY_MESH: the whole chunk
+        std::vector<render::PooledCubeRenderer::FaceVertex> vertices;
+        std::exception_ptr              error;
+
+        void *                          pOwner;
+        MeshTask *                      pNext;      // LockFreeQueueT link
+    };
+
+    // Snapshot dirty sections for Mesh, nullptr if clean.
+    // ppNeighbour: chunk next to each face, or nullptr.
+    // Until EndMesh, edits only mark sections dirty again.
+    std::unique_ptr<MeshTask> BeginMesh(int bx, int by, int bz, const BlockCubeT * const * ppNeighbour)
+    {
+        if (!IsDirty())
+            return nullptr;
+
+        Rebalance();
+        if (sparseInfo || typeInfo.IsUniform())
+            ReleaseRows();
+        else if (!HasRows())
+            BuildRows();
+
+        std::unique_ptr<MeshTask> task(new MeshTask);
+
+        GetOccupancy(&task->occupancy);
+        for (int f = 0; f < FACE_COUNT; ++f)
+        {
+            GetBorder(ppNeighbour[f], f, task->border[f]);
+        }
+        task->sections  = dirtySections;
+        task->mode      = meshMode;
+        task->epoch     = meshEpoch;
+        task->bx        = bx;
+        task->by        = by;
+        task->bz        = bz;
+        task->pOwner    = nullptr;
+        task->pNext     = nullptr;
+
+        if (meshMode == INSTANCE_MESH && HasRows() && !instanceRows.empty())
+        {
+            task->instanceRows.swap(instanceRows);
+        }
+        else if (meshMode == INSTANCE_MESH)
+        {
+            task->instanceRows.assign(L * L, 0);
+            for (size_t i = 0; i < instances.Size(); ++i)
+            {
+                int lx, ly, lz, t;
+                render::PooledCubeRenderer::UnpackCubeInstance(instances.Data()[i], &lx, &ly, &lz, &t);
+                task->instanceRows[lz * L + ly] |= 1ull << lx;
+            }
+        }
+        else
+        {
+            task->typeInfo = typeInfo;
+            if (sparseInfo)
+                task->sparseInfo.reset(new SparseStorage(*sparseInfo));
+        }
+
+        dirtySections = 0;
+        return task;
+    }
+    // Plane of neighbour n touching face f of this chunk, see MeshTask::border.
+    static void GetBorder(const BlockCubeT * n, int f, uint64_t * plane)
+    {
+        std::fill(plane, plane + L, 0ull);
+        if (!n)
+            return;
+
+        const Int2 ALL = { 0, L - 1 };
+        switch (f)
+        {
+            case NEG_X:
+            case POS_X:
+            {
+                int lx = f == NEG_X ? L - 1 : 0;
+                n->VisitOccupancy({ lx, lx }, ALL, ALL,
+                                  [plane, lx] (int ly, int lz, uint64_t bits) { plane[lz] |= (bits >> lx) << ly; });
+                break;
+            }
+            case NEG_Y:
+            case POS_Y:
+            {
+                int ly = f == NEG_Y ? L - 1 : 0;
+                n->VisitOccupancy(ALL, { ly, ly }, ALL,
+                                  [plane] (int, int lz, uint64_t bits) { plane[lz] = bits; });
+                break;
+            }
+            default:
+            {
+                int lz = f == NEG_Z ? L - 1 : 0;
+                n->VisitOccupancy(ALL, ALL, { lz, lz },
+                                  [plane] (int ly, int, uint64_t bits) { plane[ly] = bits; });
+                break;
+            }
+        }
+    }
+    // Reads and writes the task only, safe on any thread.
+    static void Mesh(MeshTask & task)
+    {
+        switch (task.mode)
+        {
+            case FACE_MESH:     MeshFaces(task); break;
+            case GREEDY_MESH:   MeshGreedy(task); break;
+            default:            MeshInstances(task); break;
+        }
+    }
+    // Per face, bit lx set if that neighbour of block (lx, ly, lz) is solid.
+    static void GetNeighbourRows(const MeshTask & task, int ly, int lz, uint64_t * n)
+    {
+        const RowArray &    occ = task.occupancy;
+        uint64_t            row = occ[lz * L + ly];
+
+        n[NEG_X] = (row << 1) | ((task.border[NEG_X][lz] >> ly) & 1);
+        n[POS_X] = (row >> 1) | (((task.border[POS_X][lz] >> ly) & 1) << (L - 1));
+        n[NEG_Y] = ly > 0     ? occ[lz * L + ly - 1]   : task.border[NEG_Y][lz];
+        n[POS_Y] = ly < L - 1 ? occ[lz * L + ly + 1]   : task.border[POS_Y][lz];
+        n[NEG_Z] = lz > 0     ? occ[(lz - 1) * L + ly] : task.border[NEG_Z][ly];
+        n[POS_Z] = lz < L - 1 ? occ[(lz + 1) * L + ly] : task.border[POS_Z][ly];
+    }
+    // Diff exposed blocks of the task's sections against its instanceRows.
+    // A block is exposed if any of its 6 neighbours is empty.
+    static void MeshInstances(MeshTask & task)
+    {
+        const uint64_t FULL_ROW = (1ull << SECTION) - 1;
+
+        for (int s = 0; s < SECTION_COUNT; ++s)
+        {
+            if (!((task.sections >> s) & 1))
+                continue;
+
+            int x0 = s % SECTION_AXIS * SECTION;
+            int y0 = s / SECTION_AXIS % SECTION_AXIS * SECTION;
+            int z0 = s / (SECTION_AXIS * SECTION_AXIS) * SECTION;
+
+            for (int lz = z0; lz < z0 + SECTION; ++lz)
+            for (int ly = y0; ly < y0 + SECTION; ++ly)
+            {
+                uint64_t row = task.occupancy[lz * L + ly];
+                uint64_t n[FACE_COUNT];
+                GetNeighbourRows(task, ly, lz, n);
+
+                uint64_t covered = n[NEG_X] & n[POS_X] & n[NEG_Y] & n[POS_Y] & n[NEG_Z] & n[POS_Z];
+
+                uint64_t &  w       = task.instanceRows[lz * L + ly];
+                uint64_t    bits    = row & ~covered & (FULL_ROW << x0);
+                uint64_t    diff    = (w & (FULL_ROW << x0)) ^ bits;
+                if (diff == 0)
+                    continue;
+
+                w ^= diff;
+
+                // keys of a row are its bit positions plus the row's first key
+                uint32_t key0 = static_cast<uint32_t>((lz * L + ly) * L);
+                AppendBits(&task.added, diff & bits, key0);
+                AppendBits(&task.removed, diff & ~bits, key0);
+            }
+        }
+    }
+    static void AppendBits(std::vector<uint32_t> * pOut, uint64_t bits, uint32_t base)
+    {
+        if (bits == 0)
+            return;
+
+        uint32_t    positions[64];
+        size_t      n = ExpandBits(bits, base, positions);
+        pOut->insert(pOut->end(), positions, positions + n);
+    }
+    // Rows of one solid type, from a MeshTask's copy of the storage.
+    struct TypeRows
+    {
+        BlockType                   type;
+        std::vector<uint64_t>       rows;
+    };
+    // Split the task's storage by type, no entry for types with no blocks.
+    static void GetTypeRows(const MeshTask & task, std::vector<TypeRows> * pTypeRows)
+    {
+        auto rowsOf = [pTypeRows] (BlockType t) -> std::vector<uint64_t> &
+        {
+            for (TypeRows & e : *pTypeRows)
+            {
+                if (e.type == t)
+                    return e.rows;
+            }
+            pTypeRows->push_back({ t, std::vector<uint64_t>(L * L, 0) });
+            return pTypeRows->back().rows;
+        };
+
+        if (task.sparseInfo)
+        {
+            task.sparseInfo->ForEachLeaf(
+                [&rowsOf] (int x, int y, int z, int size, BlockType t)
+                {
+                    if (t == EMPTY_BLOCK)
+                        return;
+
+                    std::vector<uint64_t> & rows = rowsOf(t);
+                    uint64_t                bits = (~0ull >> (64 - size)) << x;
+                    for (int lz = z; lz < z + size; ++lz)
+                    for (int ly = y; ly < y + size; ++ly)
+                    {
+                        rows[lz * L + ly] |= bits;
+                    }
+                });
+            return;
+        }
+        if (Layout::ROW_CONTIGUOUS)
+        {
+            // a row's bits of a type straight from the packed indices
+            task.typeInfo.ForEachType(
+                [&task, &rowsOf] (BlockType t, size_t)
+                {
+                    if (t == EMPTY_BLOCK)
+                        return;
+
+                    std::vector<uint64_t> & rows = rowsOf(t);
+                    for (int r = 0; r < L * L; ++r)
+                    {
+                        if (task.occupancy[r] != 0)
+                            rows[r] = task.typeInfo.Match(Index(0, r % L, r / L), L, t);
+                    }
+                });
+            return;
+        }
+        VisitRows(task.typeInfo, nullptr, { 0, L - 1 }, { 0, L - 1 }, { 0, L - 1 },
+                  [&rowsOf] (int lx, int ly, int lz, int count, const BlockType * types, BlockType t)
+                  {
+                      if (!types)
+                      {
+                          if (t != EMPTY_BLOCK)
+                              rowsOf(t)[lz * L + ly] |= (~0ull >> (64 - count)) << lx;
+                          return;
+                      }
+                      // one lookup per run of a type
+                      for (int i = 0, j; i < count; i = j)
+                      {
+                          for (j = i + 1; j < count && types[j] == types[i]; ++j)
+                              ;
+                          if (types[i] != EMPTY_BLOCK)
+                              rowsOf(types[i])[lz * L + ly] |= (~0ull >> (64 - (j - i))) << (lx + i);
+                      }
+                  });
+    }
+    // Quad per solid block face whose neighbour is empty, whole chunk.
+    static void MeshFaces(MeshTask & task)
+    {
+        std::vector<TypeRows> typeRows;
+        GetTypeRows(task, &typeRows);
+
+        for (int lz = 0; lz < L; ++lz)
+        for (int ly = 0; ly < L; ++ly)
+        {
+            if (task.occupancy[lz * L + ly] == 0)
+                continue;
+
+            uint64_t n[FACE_COUNT];
+            GetNeighbourRows(task, ly, lz, n);
+
+            for (const TypeRows & e : typeRows)
+            {
+                uint64_t row = e.rows[lz * L + ly];
+                for (int f = 0; row != 0 && f < FACE_COUNT; ++f)
+                {
+                    uint64_t bits = row & ~n[f];
+                    if (bits == 0)
+                        continue;
+
+                    // x is the low field of a vertex: the quad of block lx
+                    // is the quad of block 0 plus lx
+                    render::PooledCubeRenderer::FaceVertex quad[4];
+                    MakeQuad(quad, f, e.type, 0, ly, lz, 1, 1, 1);
+
+                    uint32_t    positions[64];
+                    size_t      count = ExpandBits(bits, 0, positions);
+                    size_t      v = task.vertices.size();
+
+                    task.vertices.resize(v + 4 * count);
+                    render::PooledCubeRenderer::FaceVertex * p = &task.vertices[v];
+                    for (size_t i = 0; i < count; ++i, p += 4)
+                    {
+                        p[0] = quad[0] + positions[i];
+                        p[1] = quad[1] + positions[i];
+                        p[2] = quad[2] + positions[i];
+                        p[3] = quad[3] + positions[i];
+                    }
+                }
+            }
+        }
+    }
+    // Visible faces merged into maximal rectangles of one block type,
+    // whole chunk.
+    static void MeshGreedy(MeshTask & task)
+    {
+        std::vector<TypeRows> typeRows;
+        GetTypeRows(task, &typeRows);
+
+        std::vector<uint64_t> planes(FACE_COUNT * L * L);
+
+        for (const TypeRows & e : typeRows)
+        {
+            MeshGreedyType(task, e, &planes);
+        }
+    }
+    // Rectangles of one type, pPlanes is scratch of FACE_COUNT * L * L words.
+    static void MeshGreedyType(MeshTask & task, const TypeRows & e, std::vector<uint64_t> * pPlanes)
+    {
+        // per face, per slice along the normal, a bit plane of visible faces:
+        // X: bit ly of [lx][lz], Y: bit lx of [ly][lz], Z: bit lx of [lz][ly]
+        std::vector<uint64_t> & planes = *pPlanes;
+        uint64_t                rows[2][L];
+
+        for (int lz = 0; lz < L; ++lz)
+        {
+            for (int ly = 0; ly < L; ++ly)
+            {
+                uint64_t row = e.rows[lz * L + ly];
+                uint64_t n[FACE_COUNT];
+                GetNeighbourRows(task, ly, lz, n);
+
+                rows[0][ly] = row & ~n[NEG_X];
+                rows[1][ly] = row & ~n[POS_X];
+                for (int f = NEG_Y; f <= POS_Y; ++f)
+                    planes[(f * L + ly) * L + lz] = row & ~n[f];
+                for (int f = NEG_Z; f <= POS_Z; ++f)
+                    planes[(f * L + lz) * L + ly] = row & ~n[f];
+            }
+            // X faces run along y, turn the x rows into y rows
+            for (int f = NEG_X; f <= POS_X; ++f)
+            {
+                TransposeRows(rows[f]);
+                for (int lx = 0; lx < L; ++lx)
+                    planes[(f * L + lx) * L + lz] = rows[f][lx];
+            }
+        }
+
+        for (int f = 0; f < FACE_COUNT; ++f)
+        for (int d = 0; d < L; ++d)
+        {
+            uint64_t * plane = &planes[(f * L + d) * L];
+            for (int r = 0; r < L; ++r)
+            {
+                while (plane[r] != 0)
+                {
+                    // plane rows have no bits past L, runs stop there
+                    int         b   = CountTrailingZeros(plane[r]);
+                    int         bw  = CountTrailingZeros(~(plane[r] >> b));
+
+                    // grow the run over the next rows while they cover it
+                    uint64_t    run = (bw == 64 ? ~0ull : (1ull << bw) - 1) << b;
+                    int         rh  = 1;
+                    while (r + rh < L && (plane[r + rh] & run) == run)
+                        plane[r + rh++] &= ~run;
+                    plane[r] &= ~run;
+
+                    // bits b..b+bw of rows r..r+rh on slice d
+                    switch (f >> 1)
+                    {
+                        case 0:     EmitQuad(&task.vertices, f, e.type, d, b, r, 1, bw, rh); break;
+                        case 1:     EmitQuad(&task.vertices, f, e.type, b, d, r, bw, 1, rh); break;
+                        default:    EmitQuad(&task.vertices, f, e.type, b, r, d, bw, rh, 1); break;
+                    }
+                }
+            }
+        }
+    }
+    // L x L bit matrix: bit j of a[i] <-> bit i of a[j].
+    static void TransposeRows(uint64_t * a)
+    {
+        uint64_t m = (1ull << (L / 2)) - 1;
+        for (int j = L / 2; j != 0; j >>= 1, m ^= m << j)
+        {
+            for (int k = 0; k < L; k = ((k | j) + 1) & ~j)
+            {
+                uint64_t t = ((a[k] >> j) ^ a[k | j]) & m;
+                a[k] ^= t << j;
+                a[k | j] ^= t;
+            }
+        }
+    }
+    static void EmitQuad(std::vector<render::PooledCubeRenderer::FaceVertex> * pVertices,
+                         int f, BlockType t, int lx, int ly, int lz, int sx, int sy, int sz)
+    {
+        render::PooledCubeRenderer::FaceVertex quad[4];
+        MakeQuad(quad, f, t, lx, ly, lz, sx, sy, sz);
+        pVertices->insert(pVertices->end(), quad, quad + 4);
+    }
+    // Quad on face f of the type t block rectangle starting at block
+    // (lx, ly, lz), sx x sy x sz blocks, 1 along the face normal.
+    // Corners go counter-clockwise seen from outside.
+    static void MakeQuad(render::PooledCubeRenderer::FaceVertex * quad,
+                         int f, BlockType t, int lx, int ly, int lz, int sx, int sy, int sz)
+    {
+        // u x v = face normal
+        static const int U_AXIS[FACE_COUNT] = { 2, 1, 0, 2, 1, 0 };
+        static const int V_AXIS[FACE_COUNT] = { 1, 2, 2, 0, 0, 1 };
+
+        int c[3] = { lx, ly, lz };
+        int s[3] = { sx, sy, sz };
+        if (f & 1)
+            ++c[f >> 1];   // positive face: far side of the block
+
+        for (int k = 0; k < 4; ++k)
+        {
+            int p[3] = { c[0], c[1], c[2] };
+            p[U_AXIS[f]] += (k == 1 || k == 2) ? s[U_AXIS[f]] : 0;
+            p[V_AXIS[f]] += (k >= 2) ? s[V_AXIS[f]] : 0;
+
+            quad[k] = render::PooledCubeRenderer::PackFaceVertex(p[0], p[1], p[2], f, t);
+        }
+    }
+    // Undo BeginMesh for a task whose Mesh failed: its sections are dirty
+    // again. instanceRows it took are rebuilt from instances next time.
+    void AbortMesh(const MeshTask & task)
+    {
+        dirtySections |= task.sections;
+    }
+    // Apply the task's mesh, unless the mesh was dropped since BeginMesh.
+    // Changed instance slots are left dirty in 'instances' for upload.
+    void EndMesh(MeshTask & task)
+    {
+        if (task.epoch != meshEpoch)
+            return;
+
+        if (meshMode != INSTANCE_MESH)
+        {
+            faceVertices.swap(task.vertices);
+            return;
+        }
+
+        if (HasRows())
+            instanceRows.swap(task.instanceRows);
+
+        for (uint32_t key : task.removed)
+        {
+            instances.Erase(key);
+        }
+        for (uint32_t key : task.added)
+        {
+            int lx = key % L;
+            int ly = key / L % L;
+            int lz = key / (L * L);
+
+            // cleared since BeginMesh: no instance, the next mesh sees it
+            BlockType t = Get(lx, ly, lz);
+            if (t == EMPTY_BLOCK)
+            {
+                if (HasRows())
+                    instanceRows[lz * L + ly] &= ~(1ull << lx);
+                continue;
+            }
+            instances.Set(key, render::PooledCubeRenderer::PackCubeInstance(lx, ly, lz, t));
+        }
+    }
+};
+// uniform: no words, 1 ~ 16 bits: VOLUME / 8 ~ VOLUME * 2 bytes (64: 32KB ~ 512KB)
+typedef BlockCubeT<ChunkGeometry, ChunkLayoutT> BlockCube;
+
+template <typename TGeometry>
+struct PositionT
+{
+    int bx, by, bz;
+    int lx, ly, lz;
+
+    PositionT(int x, int y, int z)
+        : bx(TGeometry::Chunk(x))
+        , by(TGeometry::Chunk(y))
+        , bz(TGeometry::Chunk(z))
+        , lx(TGeometry::Local(x))
+        , ly(TGeometry::Local(y))
+        , lz(TGeometry::Local(z))
+    {}
+};
+typedef PositionT<ChunkGeometry> Position;
+
+static inline
+int64_t DistanceSq(int x0, int y0, int z0, int x1, int y1, int z1)
+{
+    int64_t dx = x1 - x0, dy = y1 - y0, dz = z1 - z0;
+    return dx * dx + dy * dy + dz * dz;
+}
+
+
+// 1. manage BlockCube
+// 2. schdule sync
+class BlockSystemImpl
+{
+    typedef BlockCube::MeshTask MeshTask;
+    struct Node;
+    template <typename N> struct ChunkCursorT;
+    typedef ChunkCursorT<const Node>    ChunkCursor;
+    typedef ChunkCursorT<Node>          NodeCursor;
+
+public:
+    BlockSystemImpl()
+        : m_id(NextId())
+        , m_nBlockCube(0)
+        , m_cameraChunk{ 0, 0, 0 }
+        , m_residency(DEFAULT_GPU_BUDGET, MAX_POOL_SIZE)
+        , m_meshMode(INSTANCE_MESH)
+        , m_nMeshing(0)
+        , m_setCursor()
+    {
+        m_nMaxMeshing = MESHING_PER_THREAD * m_workers.GetThreadCount();
+
+        std::fill(m_blockLo, m_blockLo + 3, INT_MAX);
+        std::fill(m_blockHi, m_blockHi + 3, INT_MIN);
+
+        m_residency.SetEvictCallback(
+            [this] (void * pOwner, int nSlot)
+            {
+                Node & u = *static_cast<Node *>(pOwner);
+
+                u.slot = ResidencyManager::NONE;
+                m_renderer->ReleaseInstanceBuffer(nSlot);
+                MarkSlotless(u);
+            });
+        m_residency.SetMoveCallback(
+            [this] (void * pOwner, int nFrom, int nTo)
+            {
+                static_cast<Node *>(pOwner)->slot = nTo;
+                m_renderer->MoveInstanceBuffer(nFrom, nTo);
+            });
+    }
+
+    // Operations
+
+    void        Set(int x, int y, int z, BlockType t)
+    {
+        Position        pos(x, y, z);
+        Node *          p = Seek(&m_setCursor, pos.bx, pos.by, pos.bz);
+        Node &          u = p ? *p : GetOrCreateNode(pos.bx, pos.by, pos.bz);
+
+        u.sceneInfo->Set(pos.lx, pos.ly, pos.lz, t);
+        Enqueue(u, pos.bx, pos.by, pos.bz);
+    }
+    // inclusive box, clipped to each touched chunk
+    void        Set(Int2 xx, Int2 yy, Int2 zz, BlockType t)
+    {
+        Position a(xx._0, yy._0, zz._0);
+        Position b(xx._1, yy._1, zz._1);
+
+        const int L = ChunkGeometry::LENGTH;
+
+        for (int bz = a.bz; bz <= b.bz; ++bz)
+        for (int by = a.by; by <= b.by; ++by)
+        for (int bx = a.bx; bx <= b.bx; ++bx)
+        {
+            Cube            c = { xx, yy, zz };
+            Cube            cb = { {bx * L, bx * L + L - 1}, {by * L, by * L + L - 1}, {bz * L, bz * L + L - 1} };
+
+            c.ClampBy(cb);
+            c.Translate(-bx * L, -by * L, -bz * L);
+
+            // clearing never creates chunks
+            Node * u = t == EMPTY_BLOCK ?
+                m_worldMap.Find(bx, by, bz) :
+                &GetOrCreateNode(bx, by, bz);
+            if (!u)
+                continue;
+
+            u->sceneInfo->Set(c.xx, c.yy, c.zz, t);
+            Enqueue(*u, bx, by, bz);
+        }
+    }
+    void        Set(const BlockEdit * pEdits, size_t nCount)
+    {
+        if (nCount == 0)
+            return;
+
+        const int S = ChunkGeometry::SHIFT;
+        const int M = ChunkGeometry::MASK;
+
+        // 1. chunk bounds of the batch
+        int x0 = INT_MAX, y0 = INT_MAX, z0 = INT_MAX;
+        int x1 = INT_MIN, y1 = INT_MIN, z1 = INT_MIN;
+        for (size_t i = 0; i < nCount; ++i)
+        {
+            x0 = std::min(x0, pEdits[i].x); x1 = std::max(x1, pEdits[i].x);
+            y0 = std::min(y0, pEdits[i].y); y1 = std::max(y1, pEdits[i].y);
+            z0 = std::min(z0, pEdits[i].z); z1 = std::max(z1, pEdits[i].z);
+        }
+        x0 >>= S; y0 >>= S; z0 >>= S;
+
+        // chunk key: chunk offset from (x0, y0, z0), as few bits as the batch spans
+        int nBitX = BitWidth(static_cast<uint32_t>((x1 >> S) - x0));
+        int nBitY = BitWidth(static_cast<uint32_t>((y1 >> S) - y0));
+        int nBitZ = BitWidth(static_cast<uint32_t>((z1 >> S) - z0));
+        int nBit  = nBitX + nBitY + nBitZ;
+
+        // the key holds the batch span in 63 bits, about 2^21 chunks an
+        // axis; wider batches, edits far apart, go one edit at a time
+        if (nBit >= 64)
+        {
+            for (size_t i = 0; i < nCount; ++i)
+            {
+                Set(pEdits[i].x, pEdits[i].y, pEdits[i].z, pEdits[i].type);
+            }
+            return;
+        }
+
+        // 2. decompose positions into chunk key and storage index, branch free
+        m_editKeys.resize(nCount);
+        m_editIndices.resize(nCount);
+        for (size_t i = 0; i < nCount; ++i)
+        {
+            const BlockEdit & e = pEdits[i];
+
+            m_editKeys[i] = static_cast<uint64_t>((e.x >> S) - x0)
+                | (static_cast<uint64_t>((e.y >> S) - y0) << nBitX)
+                | (static_cast<uint64_t>((e.z >> S) - z0) << (nBitX + nBitY));
+            m_editIndices[i] = static_cast<uint32_t>(BlockCube::Index(e.x & M, e.y & M, e.z & M));
+        }
+
+        // 3. stable LSD radix sort of edit order by chunk key, 8 bits a pass
+        m_editOrder.resize(nCount);
+        m_editScratch.resize(nCount);
+        for (size_t i = 0; i < nCount; ++i)
+        {
+            m_editOrder[i] = static_cast<uint32_t>(i);
+        }
+        for (int shift = 0; shift < nBit; shift += 8)
+        {
+            size_t offset[257] = {};
+            for (size_t i = 0; i < nCount; ++i)
+            {
+                ++offset[((m_editKeys[i] >> shift) & 0xff) + 1];
+            }
+            for (int d = 0; d < 256; ++d)
+            {
+                offset[d + 1] += offset[d];
+            }
+            for (size_t i = 0; i < nCount; ++i)
+            {
+                uint32_t j = m_editOrder[i];
+                m_editScratch[offset[(m_editKeys[j] >> shift) & 0xff]++] = j;
+            }
+            m_editOrder.swap(m_editScratch);
+        }
+
+        // 4. one lookup and one dirty mark per chunk
+        for (size_t i0 = 0, i1; i0 < nCount; i0 = i1)
+        {
+            uint64_t    key = m_editKeys[m_editOrder[i0]];
+            bool        hasSolid = false;
+
+            for (i1 = i0; i1 < nCount && m_editKeys[m_editOrder[i1]] == key; ++i1)
+            {
+                hasSolid |= pEdits[m_editOrder[i1]].type != EMPTY_BLOCK;
+            }
+
+            int bx = x0 + static_cast<int>(key & ((1ull << nBitX) - 1));
+            int by = y0 + static_cast<int>((key >> nBitX) & ((1ull << nBitY) - 1));
+            int bz = z0 + static_cast<int>(key >> (nBitX + nBitY));
+
+            // clearing never creates chunks
+            Node * u = hasSolid ?
+                &GetOrCreateNode(bx, by, bz) :
+                m_worldMap.Find(bx, by, bz);
+            if (!u)
+                continue;
+
+            BlockCube * bc = u->sceneInfo.get();
+            uint64_t    dirty = 0;
+            for (size_t i = i0; i < i1; ++i)
+            {
+                const BlockEdit & e = pEdits[m_editOrder[i]];
+
+                if (bc->Put(m_editIndices[m_editOrder[i]], e.type) != e.type)
+                    dirty |= BlockCube::SectionBit(e.x & M, e.y & M, e.z & M);
+            }
+            bc->dirtySections |= dirty;
+            Enqueue(*u, bx, by, bz);
+        }
+    }
+    void        Unset(int x, int y, int z)
+    {
+        Set(x, y, z, EMPTY_BLOCK);
+    }
+    void        Unset(Int2 xx, Int2 yy, Int2 zz)
+    {
+        Set(xx, yy, zz, EMPTY_BLOCK);
+    }
+    BlockType   Query(int x, int y, int z) const
+    {
+        // a cursor per thread: Query is const and may run on any thread.
+        // Tagged with the system, a thread may query several.
+        static thread_local uint64_t    cursorId = 0;
+        static thread_local ChunkCursor cursor = {};
+        if (cursorId != m_id)
+        {
+            cursorId    = m_id;
+            cursor      = {};
+        }
+
+        Position                pos(x, y, z);
+        const Node *            u = Seek(&cursor, pos.bx, pos.by, pos.bz);
+
+        return u ? u->sceneInfo->Get(pos.lx, pos.ly, pos.lz) : EMPTY_BLOCK;
+    }
+    // inclusive box, chunk by chunk, one lookup per chunk
+    void        Visit(Int2 xx, Int2 yy, Int2 zz, const BlockRunVisitor & visitor) const
+    {
+        Position a(xx._0, yy._0, zz._0);
+        Position b(xx._1, yy._1, zz._1);
+
+        const int L = ChunkGeometry::LENGTH;
+
+        for (int bz = a.bz; bz <= b.bz; ++bz)
+        for (int by = a.by; by <= b.by; ++by)
+        for (int bx = a.bx; bx <= b.bx; ++bx)
+        {
+            Cube            c = { xx, yy, zz };
+            Cube            cb = { {bx * L, bx * L + L - 1}, {by * L, by * L + L - 1}, {bz * L, bz * L + L - 1} };
+
+            c.ClampBy(cb);
+            c.Translate(-bx * L, -by * L, -bz * L);
+
+            auto emit = [&] (int lx, int ly, int lz, int count, const BlockType * types, BlockType t)
+            {
+                BlockRun r = { bx * L + lx, by * L + ly, bz * L + lz, count, types, t };
+                visitor(r);
+            };
+
+            const Node * u = m_worldMap.Find(bx, by, bz);
+            if (u)
+            {
+                u->sceneInfo->VisitRows(c.xx, c.yy, c.zz, emit);
+            }
+            else
+            {
+                for (int lz = c.zz._0; lz <= c.zz._1; ++lz)
+                for (int ly = c.yy._0; ly <= c.yy._1; ++ly)
+                {
+                    emit(c.xx._0, ly, lz, c.xx._1 - c.xx._0 + 1, nullptr, EMPTY_BLOCK);
+                }
+            }
+        }
+    }
+
+    // Amanatides-Woo grid walk. Empty space is crossed one empty aligned
+    // cube at a time, see EmptySize; a step to the next block is a leap
+    // out of a 1^3 cube. RaycastPacket does the same arithmetic, so both
+    // agree on every ray.
+    bool        Raycast(float ox, float oy, float oz, float dx, float dy, float dz,
+                        float maxDistance, BlockRayHit * pHit) const
+    {
+        float len = std::sqrt(dx * dx + dy * dy + dz * dz);
+        if (!IsValidRay(ox, oy, oz, len, maxDistance))
+            return false;
+
+        // grid space: block c covers [c, c + 1)
+        float   p[3]        = { ox + 0.5f, oy + 0.5f, oz + 0.5f };
+        float   d[3]        = { dx / len, dy / len, dz / len };
+        float   rd[3];
+        int     c[3];           // current block
+        int     step[3];
+        float   tNext[3];       // to leave block c, per axis
+        int     n[3]        = { 0, 0, 0 };  // normal of the face c was entered by
+
+        for (int i = 0; i < 3; ++i)
+        {
+            c[i]        = static_cast<int>(std::floor(p[i]));
+            step[i]     = d[i] > 0.0f ? 1 : -1;
+            rd[i]       = 1.0f / d[i];
+            tNext[i]    = ExitDistance(p[i], d[i], rd[i], d[i] > 0.0f ? c[i] + 1 : c[i]);
+        }
+
+        ChunkCursor     cursor  = {};
+        float           t       = 0.0f;
+
+        while (t <= maxDistance && !IsPastChunks(c, d))
+        {
+            Position            pos(c[0], c[1], c[2]);
+            const Node *        u       = Seek(&cursor, pos.bx, pos.by, pos.bz);
+            const BlockCube *   bc      = u ? u->sceneInfo.get() : nullptr;
+            int                 size    = EmptySize(bc, pos);
+
+            if (size == 0)
+            {
+                pHit->x         = c[0];
+                pHit->y         = c[1];
+                pHit->z         = c[2];
+                pHit->nx        = n[0];
+                pHit->ny        = n[1];
+                pHit->nz        = n[2];
+                pHit->px        = c[0] + n[0];
+                pHit->py        = c[1] + n[1];
+                pHit->pz        = c[2] + n[2];
+                pHit->distance  = t;
+                pHit->type      = bc->Get(pos.lx, pos.ly, pos.lz);
+                return true;
+            }
+
+            // leave the empty cube by the nearest face, ties to the later axis
+            int     a;
+            if (size == 1)
+            {
+                // next block
+                a = tNext[0] < tNext[1] ? (tNext[0] < tNext[2] ? 0 : 2) : (tNext[1] < tNext[2] ? 1 : 2);
+                t = tNext[a];
+                c[a] += step[a];
+                tNext[a] = ExitDistance(p[a], d[a], rd[a], d[a] > 0.0f ? c[a] + 1 : c[a]);
+            }
+            else
+            {
+                int     lo[3];
+                float   tExit[3];
+                for (int i = 0; i < 3; ++i)
+                {
+                    lo[i]       = c[i] & ~(size - 1);
+                    tExit[i]    = ExitDistance(p[i], d[i], rd[i], d[i] > 0.0f ? lo[i] + size : lo[i]);
+                }
+                a = tExit[0] < tExit[1] ? (tExit[0] < tExit[2] ? 0 : 2) : (tExit[1] < tExit[2] ? 1 : 2);
+                t = tExit[a];
+
+                for (int i = 0; i < 3; ++i)
+                {
+                    // exit axis: first block past the face, others: where the ray is, kept in the cube
+                    if (i == a)
+                        c[i] = d[i] > 0.0f ? lo[i] + size : lo[i] - 1;
+                    else
+                        c[i] = std::min(std::max(static_cast<int>(std::floor(p[i] + d[i] * t)), lo[i]), lo[i] + size - 1);
+                    tNext[i] = ExitDistance(p[i], d[i], rd[i], d[i] > 0.0f ? c[i] + 1 : c[i]);
+                }
+            }
+            n[0] = n[1] = n[2] = 0;
+            n[a] = -step[a];
+        }
+        return false;
+    }
+
+    // Rays in packets of 4.
+    void        Raycast(const BlockRay * pRays, size_t nCount, BlockRayHit * pHits) const
+    {
+        for (size_t i = 0; i < nCount; i += 4)
+        {
+            RaycastPacket(pRays + i, static_cast<int>(std::min<size_t>(nCount - i, 4)), pHits + i);
+        }
+    }
+    // The grid walk of Raycast for up to 4 rays side by side. Each lane
+    // looks up its own empty cube, then all lanes leap out of theirs in
+    // SSE2: a step to the next block is a leap out of a 1^3 cube.
+    void        RaycastPacket(const BlockRay * pRays, int nRay, BlockRayHit * pHits) const
+    {
+        alignas(16) float   p[3][4], d[3][4], t[4];
+        alignas(16) int     c[3][4], n[3][4], size[4];
+        float               maxT[4];
+        int                 active = 0;     // bit per lane still walking
+
+        for (int k = 0; k < 4; ++k)
+        {
+            // unused lanes copy ray 0 and stay inactive
+            const BlockRay &    r   = pRays[k < nRay ? k : 0];
+            float               len = std::sqrt(r.dx * r.dx + r.dy * r.dy + r.dz * r.dz);
+            bool                ok  = IsValidRay(r.ox, r.oy, r.oz, len, r.maxDistance);
+
+            float o[3]  = { r.ox, r.oy, r.oz };
+            float v[3]  = { r.dx, r.dy, r.dz };
+            for (int i = 0; i < 3; ++i)
+            {
+                p[i][k] = ok ? o[i] + 0.5f : 0.0f;
+                d[i][k] = ok ? v[i] / len : (i == 0 ? 1.0f : 0.0f);
+                c[i][k] = static_cast<int>(std::floor(p[i][k]));
+            }
+            maxT[k] = r.maxDistance;
+
+            if (k < nRay)
+            {
+                pHits[k].type = EMPTY_BLOCK;
+                if (ok)
+                    active |= 1 << k;
+            }
+        }
+
+        const __m128    ZERO    = _mm_setzero_ps();
+        const __m128    INF     = _mm_set1_ps(INFINITY);
+        const __m128i   ONE     = _mm_set1_epi32(1);
+
+        __m128  vp[3], vd[3], vrd[3];
+        __m128i vc[3], vn[3];
+        __m128i isPos[3];
+        __m128  isZero[3];
+        for (int i = 0; i < 3; ++i)
+        {
+            vp[i]       = _mm_load_ps(p[i]);
+            vd[i]       = _mm_load_ps(d[i]);
+            vrd[i]      = _mm_div_ps(_mm_set1_ps(1.0f), vd[i]);
+            vc[i]       = _mm_load_si128(reinterpret_cast<const __m128i *>(c[i]));
+            vn[i]       = _mm_setzero_si128();
+            isPos[i]    = _mm_castps_si128(_mm_cmpgt_ps(vd[i], ZERO));
+            isZero[i]   = _mm_cmpeq_ps(vd[i], ZERO);
+        }
+        __m128 vt = ZERO;
+
+        ChunkCursor     cursors[4]  = {};
+
+        while (active)
+        {
+            // 1. per lane: a hit, past maxDistance, or the empty cube to leave
+            for (int i = 0; i < 3; ++i)
+            {
+                _mm_store_si128(reinterpret_cast<__m128i *>(c[i]), vc[i]);
+                _mm_store_si128(reinterpret_cast<__m128i *>(n[i]), vn[i]);
+            }
+            _mm_store_ps(t, vt);
+
+            for (int k = 0; k < 4; ++k)
+            {
+                size[k] = 1;
+                if (!((active >> k) & 1))
+                    continue;
+
+                int     ck[3]   = { c[0][k], c[1][k], c[2][k] };
+                float   dk[3]   = { d[0][k], d[1][k], d[2][k] };
+                if (t[k] > maxT[k] || IsPastChunks(ck, dk))
+                {
+                    active &= ~(1 << k);
+                    continue;
+                }
+
+                Position            pos(c[0][k], c[1][k], c[2][k]);
+                const Node *        u   = Seek(&cursors[k], pos.bx, pos.by, pos.bz);
+                const BlockCube *   bc  = u ? u->sceneInfo.get() : nullptr;
+                int                 s   = EmptySize(bc, pos);
+                if (s == 0)
+                {
+                    BlockRayHit & h = pHits[k];
+                    h.x         = c[0][k];
+                    h.y         = c[1][k];
+                    h.z         = c[2][k];
+                    h.nx        = n[0][k];
+                    h.ny        = n[1][k];
+                    h.nz        = n[2][k];
+                    h.px        = h.x + h.nx;
+                    h.py        = h.y + h.ny;
+                    h.pz        = h.z + h.nz;
+                    h.distance  = t[k];
+                    h.type      = bc->Get(pos.lx, pos.ly, pos.lz);
+
+                    active &= ~(1 << k);
+                    continue;
+                }
+                size[k] = s;
+            }
+            if (!active)
+                break;
+
+            // 2. active lanes leave their cube by the nearest face
+            __m128i isActive    = _mm_set_epi32(-((active >> 3) & 1), -((active >> 2) & 1),
+                                                -((active >> 1) & 1), -(active & 1));
+            __m128i vs          = _mm_load_si128(reinterpret_cast<const __m128i *>(size));
+            __m128i lo[3], hi[3];
+            __m128  tExit[3];
+            for (int i = 0; i < 3; ++i)
+            {
+                // sizes are powers of 2: the cube starts at c & -size
+                lo[i]       = _mm_and_si128(vc[i], _mm_sub_epi32(_mm_setzero_si128(), vs));
+                hi[i]       = _mm_sub_epi32(_mm_add_epi32(lo[i], vs), ONE);
+
+                __m128 plane = _mm_cvtepi32_ps(Select(isPos[i], _mm_add_epi32(hi[i], ONE), lo[i]));
+                tExit[i]    = _mm_mul_ps(_mm_sub_ps(plane, vp[i]), vrd[i]);
+                tExit[i]    = _mm_or_ps(_mm_and_ps(isZero[i], INF), _mm_andnot_ps(isZero[i], tExit[i]));
+            }
+            __m128  tn          = _mm_min_ps(tExit[0], _mm_min_ps(tExit[1], tExit[2]));
+            __m128i isExit[3];
+            // ties to the later axis, as in Raycast
+            isExit[2]           = _mm_castps_si128(_mm_cmpeq_ps(tExit[2], tn));
+            isExit[1]           = _mm_andnot_si128(isExit[2], _mm_castps_si128(_mm_cmpeq_ps(tExit[1], tn)));
+            isExit[0]           = _mm_andnot_si128(_mm_or_si128(isExit[2], isExit[1]), _mm_set1_epi32(-1));
+
+            for (int i = 0; i < 3; ++i)
+            {
+                // exit axis: first block past the face, others: where the ray is, kept in the cube
+                __m128i cExit   = Select(isPos[i], _mm_add_epi32(hi[i], ONE), _mm_sub_epi32(lo[i], ONE));
+                __m128i cIn     = Clamp(Floor(_mm_add_ps(vp[i], _mm_mul_ps(vd[i], tn))), lo[i], hi[i]);
+                __m128i nExit   = Select(isPos[i], _mm_set1_epi32(-1), ONE);
+
+                vc[i] = Select(isActive, Select(isExit[i], cExit, cIn), vc[i]);
+                vn[i] = Select(isActive, _mm_and_si128(isExit[i], nExit), vn[i]);
+            }
+            vt = _mm_castsi128_ps(Select(isActive, _mm_castps_si128(tn), _mm_castps_si128(vt)));
+        }
+    }
+
+    void        Move(BlockBody * pBodies, size_t nCount) const
+    {
+        // z first: a body falling onto a ledge lands before sliding
+        static const int AXIS_ORDER[3] = { 2, 0, 1 };
+
+        // bodies near each other share chunk lookups
+        ChunkCursor cursor = {};
+
+        for (size_t i = 0; i < nCount; ++i)
+        {
+            BlockBody & body = pBodies[i];
+
+            // grid space: block c covers [c, c + 1)
+            float c[3] = { body.x + 0.5f, body.y + 0.5f, body.z + 0.5f };
+            float h[3] = { body.hx, body.hy, body.hz };
+            float m[3] = { body.dx, body.dy, body.dz };
+
+            body.contacts = 0;
+            for (int a : AXIS_ORDER)
+            {
+                if (m[a] == 0.0f)
+                    continue;
+
+                float done = Sweep(c, h, a, m[a], &cursor);
+                if (done != m[a])
+                    body.contacts |= 1 << (2 * a + (m[a] > 0.0f));
+
+                c[a] += done;
+                m[a] = done;
+            }
+
+            body.x  = c[0] - 0.5f;
+            body.y  = c[1] - 0.5f;
+            body.z  = c[2] - 0.5f;
+            body.dx = m[0];
+            body.dy = m[1];
+            body.dz = m[2];
+        }
+    }
+    // How far the box at center c, half size h, grid space, gets along
+    // axis a towards m: up to the first layer of blocks across its path
+    // holding a solid one. Layers the box overlaps already don't stop it.
+    float       Sweep(const float * c, const float * h, int a, float m, ChunkCursor * pCursor) const
+    {
+        // faces closer than this to a block boundary count as on it
+        const float SKIN = 1e-4f;
+
+        int lo[3], hi[3];
+        for (int i = 0; i < 3; ++i)
+        {
+            lo[i] = static_cast<int>(std::floor(c[i] - h[i] + SKIN));
+            hi[i] = static_cast<int>(std::ceil(c[i] + h[i] - SKIN)) - 1;
+        }
+
+        if (m > 0.0f)
+        {
+            float   face    = c[a] + h[a];
+            int     k1      = static_cast<int>(std::ceil(face + m)) - 1;
+            for (int k = static_cast<int>(std::ceil(face - SKIN)); k <= k1; ++k)
+            {
+                lo[a] = hi[a] = k;
+                if (AnySolid(lo, hi, pCursor))
+                    return std::max(k - face, 0.0f);
+            }
+        }
+        else
+        {
+            float   face    = c[a] - h[a];
+            int     k1      = static_cast<int>(std::floor(face + m));
+            for (int k = static_cast<int>(std::floor(face + SKIN)) - 1; k >= k1; --k)
+            {
+                lo[a] = hi[a] = k;
+                if (AnySolid(lo, hi, pCursor))
+                    return std::min(k + 1 - face, 0.0f);
+            }
+        }
+        return m;
+    }
+    // Any solid block in the inclusive box, see BlockCube::AnySolid:
+    // a word test per row and chunk, no per-block lookups.
+    bool        AnySolid(const int * lo, const int * hi, ChunkCursor * pCursor) const
+    {
+        const int L = ChunkGeometry::LENGTH;
+
+        Position a(lo[0], lo[1], lo[2]);
+        Position b(hi[0], hi[1], hi[2]);
+
+        for (int bz = a.bz; bz <= b.bz; ++bz)
+        for (int by = a.by; by <= b.by; ++by)
+        for (int bx = a.bx; bx <= b.bx; ++bx)
+        {
+            const Node * u = Seek(pCursor, bx, by, bz);
+            if (!u)
+                continue;
+
+            if (u->sceneInfo->AnySolid({ bx == a.bx ? a.lx : 0, bx == b.bx ? b.lx : L - 1 },
+                                       { by == a.by ? a.ly : 0, by == b.by ? b.ly : L - 1 },
+                                       { bz == a.bz ? a.lz : 0, bz == b.bz ? b.lz : L - 1 }))
+                return true;
+        }
+        return false;
+    }
+
+    // Mesh dirty chunks on workers, nearest to the camera first, and upload
+    // up to nMaxUpdate meshed chunks. Never waits for a worker.
+    void        Sync(int cx, int cy, int cz, int nMaxUpdate)
+    {
+        Position cpos(cx, cy, cz);
+
+        const int64_t   L           = ChunkGeometry::LENGTH;
+        const int64_t   nViewChunk  = (static_cast<int64_t>(VIEW_BLOCKS) + L - 1) / L + 1;
+
+        // every chunk in view range is drawn this frame
+        m_residency.Update(cpos.bx, cpos.by, cpos.bz);
+        m_residency.TouchWithin(nViewChunk * nViewChunk);
+
+        if (cpos.bx != m_cameraChunk.bx ||
+            cpos.by != m_cameraChunk.by ||
+            cpos.bz != m_cameraChunk.bz)
+        {
+            // camera crossed a chunk boundary: re-key, O(dirty + slotless chunks)
+            m_cameraChunk = { cpos.bx, cpos.by, cpos.bz };
+
+            for (DirtyRecord & r : m_dirtyQueue)
+            {
+                r.distance = DistanceSq(r.bx, r.by, r.bz, cpos.bx, cpos.by, cpos.bz);
+            }
+            std::make_heap(m_dirtyQueue.begin(), m_dirtyQueue.end(), DirtyRecord::Farther);
+
+            // meshed chunks without a slot may be near enough now,
+            // drop the ones that got a slot or lost their mesh since
+            size_t n = 0;
+            for (Node * p : m_slotless)
+            {
+                if (p->slot != ResidencyManager::NONE || p->sceneInfo->GetMeshBytes() == 0)
+                {
+                    p->isSlotless = false;
+                    continue;
+                }
+                Push(*p, p->bx, p->by, p->bz);
+                m_slotless[n++] = p;
+            }
+            m_slotless.resize(n);
+        }
+
+        // 1. meshes finished by workers, oldest first
+        for (MeshTask * p = m_meshed.TakeAll(); p != nullptr; p = p->pNext)
+        {
+            m_meshDone.push_back(p);
+        }
+
+        // 2. apply and upload them, the rest waits for the next call
+        int     nUpdated = 0;
+        size_t  nApplied = 0;
+        for (; nApplied < m_meshDone.size() && nUpdated < nMaxUpdate; ++nApplied)
+        {
+            if (Apply(*m_meshDone[nApplied]))
+                ++nUpdated;
+        }
+        m_meshDone.erase(m_meshDone.begin(), m_meshDone.begin() + nApplied);
+
+        // 3. hand the nearest dirty chunks to workers
+        while (m_nMeshing < m_nMaxMeshing && !m_dirtyQueue.empty())
+        {
+            const DirtyRecord & top = m_dirtyQueue.front();
+            Node &              u = *top.p;
+
+            // clean chunk waiting for a slot: upload only, counts as an update
+            bool isUploadOnly = !u.task && !u.sceneInfo->IsDirty();
+            if (isUploadOnly && nUpdated >= nMaxUpdate)
+                break;
+
+            std::pop_heap(m_dirtyQueue.begin(), m_dirtyQueue.end(), DirtyRecord::Farther);
+            DirtyRecord r = m_dirtyQueue.back();
+            m_dirtyQueue.pop_back();
+
+            u.isQueued = false;
 
-// 1. memory repr
-// 2. sync to GPU instance buffer
-template <int L>
-struct BlockCubeT
-{
-    std::array<BlockType, L * L * L> typeInfo;
-    bool isDirty;
+            if (u.task)
+            {
+                // re-queued by Apply if edited meanwhile
+                continue;
+            }
+            if (isUploadOnly)
+            {
+                if (Upload(u, r.bx, r.by, r.bz))
+                    ++nUpdated;
+                continue;
+            }
 
-    BlockCubeT() : isDirty(false) { typeInfo.fill(BlockType::EMPTY_BLOCK); }
+            //std::wostringstream ss;
+            //ss << L"Mesh block " << r.bx << L" " << r.by << L" " << r.bz << std::endl;
+            //OutputDebugString(ss.str().c_str());
 
-    BlockType Get(int lx, int ly, int lz) const
-    {
-        return typeInfo[lz * L * L + ly * L + lx];
-    }
-    void Set(int lx, int ly, int lz, BlockType t)
-    {
-        BlockType & t0 = typeInfo[lz * L * L + ly * L + lx];
-        isDirty = t0 != t;
-        t0 = t;
+            Dispatch(u, r.bx, r.by, r.bz);
+        }
+
+        // 4. shrink the pool once most of it is unused
+        if (m_residency.GetSlotCount() > 2 * m_residency.GetResidentCount() + POOL_SLACK)
+            ShrinkPool();
     }
-    void Set(Int2 lxx, Int2 lyy, Int2 lzz, BlockType t)
+    // Sync until no chunk is dirty or being meshed, e.g. after a teleport.
+    void        SyncAll(int cx, int cy, int cz)
     {
-        for (int lz = lzz._0; lz <= lzz._1; ++lz)
-        for (int ly = lyy._0; ly <= lyy._1; ++ly)
-        for (int lx = lxx._0; lx <= lxx._1; ++lx)
+        for (;;)
         {
-            typeInfo[lz * L * L + ly * L + lx] = t;
+            Sync(cx, cy, cz, INT_MAX);
+
+            if (m_nMeshing == 0 && m_dirtyQueue.empty())
+                break;
+
+            std::this_thread::yield();
         }
-        isDirty = true;
     }
-    int Length() const
+
+    void        SetGpuBudget(size_t nBytes)
     {
-        return L;
+        m_residency.SetBudget(nBytes);
+        ShrinkPool();
     }
-
-    bool Sync(int bx, int by, int bz,
-              render::PooledCubeRenderer * pRenderer,
-              int nIndex)
+    BlockResidencyStats GetResidencyStats() const
     {
-        if (!isDirty)
-            return false;
+        ResidencyManager::Stats     residency = m_residency.GetStats();
+        BlockResidencyStats         stats;
 
-        isDirty = false;
+        stats.nSlot         = residency.nSlot;
+        stats.nResident     = residency.nResident;
+        stats.nBytes        = residency.nBytes;
+        stats.nBudgetBytes  = residency.nBudgetBytes;
+        stats.nEvicted      = residency.nEvicted;
+        stats.nRejected     = residency.nRejected;
+        return stats;
+    }
 
-        std::vector<DirectX::XMFLOAT4> buffer(
-            typeInfo.size() - std::count(typeInfo.cbegin(), typeInfo.cend(), BlockType::EMPTY_BLOCK));
+    void        SetMeshMode(BlockMeshMode mode)
+    {
+        m_meshMode = mode;
 
-        BlockType *         pType = typeInfo.data();
-        DirectX::XMFLOAT4 * pData = buffer.data();
-        for (int lz = 0; lz < L; ++lz)
-        for (int ly = 0; ly < L; ++ly)
-        for (int lx = 0; lx < L; ++lx)
+        for (auto & p : m_worldMap)
         {
-            if (*pType == BlockType::GRASS_BLOCK)
-            {
-                *pData =
-                {
-                    static_cast<float>((bx * L + lx) * 2),
-                    static_cast<float>((by * L + ly) * 2),
-                    static_cast<float>((bz * L + lz) * 2),
-                    1.0f
-                };
-                ++pData;
-            }
-            ++pType;
-        }
-        win32::ENSURE_TRUE(buffer.data() + buffer.size() == pData);
-        
-        pRenderer->SetInstanceBuffer(nIndex,
-                                     render::PooledCubeRenderer::TEXTURE,
-                                     std::move(buffer));
+            Node & u = *p;
 
-        return true;
+            u.sceneInfo->SetMeshMode(mode);
+            Enqueue(u, u.bx, u.by, u.bz);
+        }
     }
-};
-typedef BlockCubeT<64> BlockCube; // ~1MB
 
-template <int TShift, int TAnd>
-struct PositionT
-{
-    int bx, by, bz;
-    int lx, ly, lz;
+    BlockMeshStats GetMeshStats() const
+    {
+        BlockMeshStats stats = {};
 
-    PositionT(int x, int y, int z)
-        : bx(x >> TShift)
-        , by(y >> TShift)
-        , bz(z >> TShift)
-        , lx(x & TAnd)
-        , ly(y & TAnd)
-        , lz(z & TAnd)
-    {}
-};
-typedef PositionT<6, 63> Position;
+        for (const auto & p : m_worldMap)
+        {
+            const BlockCube & bc = *p->sceneInfo;
+            if (bc.GetMeshBytes() == 0)
+                continue;
 
-static inline
-int AbsDot(int x0, int y0, int z0, int x1, int y1, int z1)
-{
-    return std::abs((x1 - x0) * (y1 - y0) * (z1 - z0));
-}
+            ++stats.nChunk;
+            stats.nTriangle += bc.GetMeshTriangles();
+            stats.nBytes    += bc.GetMeshBytes();
+        }
+        return stats;
+    }
 
+    BlockMemoryStats GetMemoryStats() const
+    {
+        SlabPool::Stats     slab = ChunkMemory::GetStats();
+        BlockMemoryStats    stats;
 
-// 1. manage BlockCube
-// 2. schdule sync
-class BlockSystemImpl
-{
-public:
-    BlockSystemImpl() : m_nBlockCube(0) {}
+        stats.nChunk        = m_nBlockCube;
+        stats.nSlab         = slab.nSlab;
+        stats.nSlabBytes    = slab.nSlabBytes;
+        stats.nUsedBytes    = slab.nUsedBytes;
+        return stats;
+    }
 
-    // Operations
+    void        BindRenderer(render::PooledCubeRenderer * pRenderer)
+    {
+        m_renderer = pRenderer;
+    }
 
-    void        Set(int x, int y, int z, BlockType t)
+private:
+
+    // Implementation
+
+    Node &                  GetOrCreateNode(int bx, int by, int bz)
     {
-        Position        pos(x, y, z);
-        BlockCube &     bc = GetOrCreateBlockCube(pos);
+        bool    isNew;
+        Node &  u = m_worldMap.FindOrInsert(bx, by, bz, &isNew);
+        if (isNew)
+        {
+            ++m_nBlockCube;
+
+            u.sceneInfo.reset(new BlockCube(m_meshMode));
+            u.bx = bx;
+            u.by = by;
+            u.bz = bz;
+            Link(u, bx, by, bz);
 
-        bc.Set(pos.lx, pos.ly, pos.lz, t);
+            const int   L       = ChunkGeometry::LENGTH;
+            int         b[3]    = { bx, by, bz };
+            for (int i = 0; i < 3; ++i)
+            {
+                m_blockLo[i] = std::min(m_blockLo[i], b[i] * L);
+                m_blockHi[i] = std::max(m_blockHi[i], b[i] * L + L - 1);
+            }
+        }
+        return u;
     }
-    void        Set(Int2 xx, Int2 yy, Int2 zz, BlockType t)
+    // Link a new chunk and the existing ones around it both ways.
+    // Chunks are never removed, see NodeMap, links never go stale.
+    void                    Link(Node & u, int bx, int by, int bz)
     {
-        Position a(xx._0, yy._0, zz._0);
-        Position b(xx._1, yy._1, zz._1);
+        for (int dz = -1; dz <= 1; ++dz)
+        for (int dy = -1; dy <= 1; ++dy)
+        for (int dx = -1; dx <= 1; ++dx)
+        {
+            int     i = NeighbourIndex(dx, dy, dz);
+            Node *  n = i == SELF ? &u : m_worldMap.Find(bx + dx, by + dy, bz + dz);
 
-        for (int bx = a.bx; bx <= b.bx; ++bx)
-        for (int by = a.by; by <= b.by; ++by)
-        for (int bz = a.bz; bz <= b.bz; ++bz)
+            u.neighbours[i] = n;
+            if (n)
+                n->neighbours[NEIGHBOUR_COUNT - 1 - i] = &u;
+        }
+    }
+    // Node of chunk (bx, by, bz), nullptr if not exist, through a cursor:
+    // the cursor chunk again is free, a chunk next to it is a link hop,
+    // anything else a map lookup.
+    const Node *            Seek(ChunkCursor * pCursor, int bx, int by, int bz) const
+    {
+        return Seek(m_worldMap, m_nBlockCube, pCursor, bx, by, bz);
+    }
+    Node *                  Seek(NodeCursor * pCursor, int bx, int by, int bz)
+    {
+        return Seek(m_worldMap, m_nBlockCube, pCursor, bx, by, bz);
+    }
+    template <typename N, typename M>
+    static N *              Seek(M & map, size_t nChunk, ChunkCursorT<N> * c, int bx, int by, int bz)
+    {
+        if (c->isValid)
         {
-            Position        p(bx, by, bz);
-            BlockCube &     bc = GetOrCreateBlockCube(p);
+            int dx = bx - c->bx, dy = by - c->by, dz = bz - c->bz;
 
-            Cube            c = { xx, yy, zz };
-            Cube            cb = { {bx, bx + bc.Length()}, {by, by + bc.Length()}, {bz, bz + bc.Length()} };
-            
-            c.ClampBy(cb);
+            // a missing chunk stays missing until a chunk is created
+            if ((dx | dy | dz) == 0 && (c->u || c->nChunk == nChunk))
+                return c->u;
 
-            bc.Set(c.xx, c.yy, c.zz, t);
+            if (c->u && dx >= -1 && dx <= 1 && dy >= -1 && dy <= 1 && dz >= -1 && dz <= 1)
+            {
+                *c = { bx, by, bz, c->u->neighbours[NeighbourIndex(dx, dy, dz)], nChunk, true };
+                return c->u;
+            }
         }
-    }   
-    void        Unset(int x, int y, int z)
+        *c = { bx, by, bz, map.Find(bx, by, bz), nChunk, true };
+        return c->u;
+    }
+    static uint64_t         NextId()
     {
-        Set(x, y, z, EMPTY_BLOCK);
+        static std::atomic<uint64_t> id(0);
+        return ++id;
     }
-    void        Unset(Int2 xx, Int2 yy, Int2 zz)
+    static int              NeighbourIndex(int dx, int dy, int dz)
     {
-        Set(xx, yy, zz, EMPTY_BLOCK);
+        return (dz + 1) * 9 + (dy + 1) * 3 + (dx + 1);
     }
-    BlockType   Query(int x, int y, int z) const
+    // Queue a chunk that became dirty, and the neighbours facing its
+    // changed border blocks.
+    void                    Enqueue(Node & u, int bx, int by, int bz)
     {
-        Position                pos(x, y, z);
-        const BlockCube &       bc = GetBlockCube(pos);
+        if (u.sceneInfo->IsDirty())
+            Push(u, bx, by, bz);
 
-        return bc.Get(pos.lx, pos.ly, pos.lz);
+        uint64_t * neighbourDirty = u.sceneInfo->neighbourDirty;
+        for (int f = 0; f < FACE_COUNT; ++f)
+        {
+            if (neighbourDirty[f] == 0)
+                continue;
+
+            int     nx = bx + FACE_NORMAL[f][0];
+            int     ny = by + FACE_NORMAL[f][1];
+            int     nz = bz + FACE_NORMAL[f][2];
+            Node *  n  = u.neighbours[NeighbourIndex(FACE_NORMAL[f][0], FACE_NORMAL[f][1], FACE_NORMAL[f][2])];
+            if (n)
+            {
+                n->sceneInfo->dirtySections |= neighbourDirty[f];
+                Push(*n, nx, ny, nz);
+            }
+            neighbourDirty[f] = 0;
+        }
     }
-    TypeCube    Query(Int2 xx, Int2 yy, Int2 zz) const
+    void                    Push(Node & u, int bx, int by, int bz)
     {
-        TypeCube    tc;
+        if (u.isQueued)
+            return;
 
-        Cube        c = { xx, yy, zz };
+        u.isQueued = true;
 
-        tc.reserve(c.Volumn());
-        for (int x = xx._0; x <= xx._1; ++x)
-        for (int y = yy._0; y <= yy._1; ++y)
-        for (int z = zz._0; z <= zz._1; ++z)
+        DirtyRecord r = { DistanceSq(bx, by, bz, m_cameraChunk.bx, m_cameraChunk.by, m_cameraChunk.bz),
+                          bx, by, bz, &u };
+        m_dirtyQueue.push_back(r);
+        std::push_heap(m_dirtyQueue.begin(), m_dirtyQueue.end(), DirtyRecord::Farther);
+    }
+    // Snapshot the chunk and mesh it on a worker, the result comes back
+    // through m_meshed.
+    void                    Dispatch(Node & u, int bx, int by, int bz)
+    {
+        const BlockCube * neighbours[FACE_COUNT];
+        for (int f = 0; f < FACE_COUNT; ++f)
         {
-            Position            p(x, y, z);
-            const BlockCube &   bc = GetBlockCube(p);
-
-            tc.push_back(
-                bc.Get(p.lx, p.ly, p.lz));
+            const Node * n = u.neighbours[NeighbourIndex(FACE_NORMAL[f][0], FACE_NORMAL[f][1], FACE_NORMAL[f][2])];
+            neighbours[f] = n ? n->sceneInfo.get() : nullptr;
         }
 
-        return tc;
-    }
+        u.task = u.sceneInfo->BeginMesh(bx, by, bz, neighbours);
+        u.task->pOwner = &u;
+        ++m_nMeshing;
 
-    void        Sync(int cx, int cy, int cz, int nMaxUpdate)
+        MeshTask * p = u.task.get();
+        m_workers.Submit(
+            [this, p] ()
+            {
+                try
+                {
+                    BlockCube::Mesh(*p);
+                }
+                catch (...)
+                {
+                    p->error = std::current_exception();
+                }
+                m_meshed.Push(p);
+            });
+    }
+    // Apply a meshed task to its chunk and upload, re-queue the chunk if
+    // it was edited meanwhile. Return true if uploaded.
+    bool                    Apply(MeshTask & task)
     {
-        struct Record
-        {
-            int bx, by, bz;
-            Node * p;
-        };
+        Node &                      u = *static_cast<Node *>(task.pOwner);
+        std::unique_ptr<MeshTask>   done(std::move(u.task));
 
-        std::vector<Record> records;
-        for (auto & kv0 : m_worldTree)
-        for (auto & kv1 : kv0.second)
-        for (auto & kv2 : kv1.second)
-        {
-            int bx = kv0.first;
-            int by = kv1.first;
-            int bz = kv2.first;
-            Record r = { bx, by, bz, &kv2.second };
+        --m_nMeshing;
 
-            records.emplace_back(r);
+        if (task.error)
+        {
+            // leave Sync's state intact, the chunk is meshed again later
+            LogMeshError(task);
+            u.sceneInfo->AbortMesh(task);
+            Push(u, task.bx, task.by, task.bz);
+            return false;
         }
 
-        Position cpos(cx, cy, cz);
-        Record c = { cpos.bx, cpos.by, cpos.bz, nullptr };
-
-        std::sort(records.begin(),
-                  records.end(),
-                  [&c] (const Record & r0, const Record & r1) -> bool
-                  {
-                      int d0 = AbsDot(r0.bx, r0.by, r0.bz, c.bx, c.by, c.bz);
-                      int d1 = AbsDot(r1.bx, r1.by, r1.bz, c.bx, c.by, c.bz);
-                      return d0 < d1;
-                  });
+        u.sceneInfo->EndMesh(task);
 
-        // sync first nMaxUpdate changed
-        int nUpdated = 0;
-        for (Record & r : records)
+        bool isUploaded = Upload(u, task.bx, task.by, task.bz);
+        Enqueue(u, task.bx, task.by, task.bz);
+        return isUploaded;
+    }
+    static void             LogMeshError(const MeshTask & task)
+    {
+        std::ostringstream ss;
+        ss << "Mesh block " << task.bx << " " << task.by << " " << task.bz << " failed: ";
+        try
         {
-            if (r.p->sceneInfo->Sync(r.bx, r.by, r.bz,
-                                     m_renderer,
-                                     r.p->rendererIndex))
-            {
-                //std::wostringstream ss;
-                //ss << L"Sync block " << r.bx << L" " << r.by << L" " << r.bz << std::endl;
-                //OutputDebugString(ss.str().c_str());
-
-                ++nUpdated;
-                if (nUpdated > nMaxUpdate)
-                    break;
-            }
+            std::rethrow_exception(task.error);
+        }
+        catch (const std::exception & e)
+        {
+            ss << e.what();
+        }
+        catch (...)
+        {
+            ss << "unknown error";
         }
+        ss << std::endl;
+        OutputDebugStringA(ss.str().c_str());
     }
+    // Remember a meshed chunk left without a slot, Sync retries it when
+    // the camera chunk changes.
+    void                    MarkSlotless(Node & u)
+    {
+        if (u.isSlotless)
+            return;
 
-    void        BindRenderer(render::PooledCubeRenderer * pRenderer)
+        u.isSlotless = true;
+        m_slotless.push_back(&u);
+    }
+    // Pack resident chunks into the lowest slots, cut the pool after them.
+    void                    ShrinkPool()
     {
-        m_renderer = pRenderer;
+        m_renderer->SetPoolSize(m_residency.Compact());
     }
+    // Keep a pool slot for a chunk with a mesh and upload what changed,
+    // release the slot of an empty chunk. Return true if uploaded.
+    bool                    Upload(Node & u, int bx, int by, int bz)
+    {
+        BlockCube & bc = *u.sceneInfo;
+        size_t       nBytes = bc.GetMeshBytes();
 
-private:
+        if (nBytes == 0)
+        {
+            if (u.slot != ResidencyManager::NONE)
+            {
+                m_residency.Release(u.slot);
+                m_renderer->ReleaseInstanceBuffer(u.slot);
+                u.slot = ResidencyManager::NONE;
+            }
+            return false;
+        }
 
-    // Implementation
+        if (u.slot == ResidencyManager::NONE)
+        {
+            u.slot = m_residency.Acquire(&u, bx, by, bz, nBytes);
+            if (u.slot == ResidencyManager::NONE)
+            {
+                MarkSlotless(u);
+                return false;
+            }
 
-    BlockCube &             GetOrCreateBlockCube(const Position & pos)
-    {
-        static size_t nextIndex = 0;
+            if (m_residency.GetSlotCount() > m_renderer->GetPoolSize())
+                m_renderer->SetPoolSize(m_residency.GetSlotCount());
+        }
+        else if (!m_residency.Touch(u.slot, nBytes))
+        {
+            return false;
+        }
+
+        const int L = ChunkGeometry::LENGTH;
 
-        auto & xy = m_worldTree[pos.bx][pos.by];
-        auto xyz = xy.find(pos.bz);
-        if (xyz != xy.end())
+        if (bc.meshMode != INSTANCE_MESH)
         {
-            return *(xyz->second.sceneInfo);
+            m_renderer->UpdateFaceBuffer(u.slot,
+                                         bc.faceVertices.data(),
+                                         bc.faceVertices.size(),
+                                         bx * L, by * L, bz * L);
         }
         else
         {
-            ++m_nBlockCube;
-
-            Node u;
-            u.sceneInfo.reset(new BlockCube);
-            // TODO: take renderer far from (cx, cy, cz)
-            u.rendererIndex = (nextIndex++) % m_renderer->GetPoolSize();
-            return *(xy.emplace_hint(xyz, pos.bz, std::move(u))->second.sceneInfo);
+            m_renderer->UpdateInstanceBuffer(u.slot,
+                                             render::PooledCubeRenderer::TEXTURE,
+                                             bc.instances,
+                                             bx * L, by * L, bz * L);
+        }
+        return true;
+    }
+    // Finite origin and distance, a direction of some length. Origins
+    // past 2^30 would overflow the block coordinates.
+    static bool             IsValidRay(float ox, float oy, float oz, float len, float maxDistance)
+    {
+        const float LIMIT = 1 << 30;
+        return len > 0.0f && len < INFINITY &&
+               std::abs(ox) < LIMIT && std::abs(oy) < LIMIT && std::abs(oz) < LIMIT &&
+               maxDistance >= 0.0f && maxDistance < INFINITY;
+    }
+    // A ray at block c along d has left every chunk for good: past them
+    // on an axis it moves away from or along. Ends walks whatever
+    // maxDistance is.
+    bool                    IsPastChunks(const int * c, const float * d) const
+    {
+        for (int i = 0; i < 3; ++i)
+        {
+            if ((c[i] < m_blockLo[i] && !(d[i] > 0.0f)) || (c[i] > m_blockHi[i] && !(d[i] < 0.0f)))
+                return true;
         }
+        return false;
+    }
+    // 0 if block pos is solid, else the edge of the empty aligned cube
+    // holding it: a missing or empty chunk, then see BlockCube::EmptySize.
+    static int              EmptySize(const BlockCube * bc, const Position & pos)
+    {
+        if (!bc)
+            return ChunkGeometry::LENGTH;
+        return bc->EmptySize(pos.lx, pos.ly, pos.lz);
+    }
+    // SSE2 has no floor and no 32-bit min, max
+    static __m128i          Floor(__m128 x)
+    {
+        __m128i i = _mm_cvttps_epi32(x);
+        // truncated up for negative non-integers: -1 where so
+        return _mm_add_epi32(i, _mm_castps_si128(_mm_cmpgt_ps(_mm_cvtepi32_ps(i), x)));
+    }
+    static __m128i          Clamp(__m128i x, __m128i lo, __m128i hi)
+    {
+        x = Select(_mm_cmplt_epi32(x, lo), lo, x);
+        return Select(_mm_cmpgt_epi32(x, hi), hi, x);
+    }
+    // mask ? a : b, per lane
+    static __m128i          Select(__m128i mask, __m128i a, __m128i b)
+    {
+        return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+    }
+    // Ray distance from p along d to the plane at coordinate plane, rd is
+    // 1 / d. Rounds as RaycastPacket does.
+    static float            ExitDistance(float p, float d, float rd, int plane)
+    {
+        if (d == 0.0f)
+            return INFINITY;
+        return (static_cast<float>(plane) - p) * rd;
     }
-    const BlockCube &       GetBlockCube(const Position & pos) const
+    // bits needed to hold v
+    static int              BitWidth(uint32_t v)
     {
-        return *(m_worldTree.at(pos.bx).at(pos.by).at(pos.bz).sceneInfo);
+        int n = 0;
+        for (; v; v >>= 1) ++n;
+        return n;
     }
 
+    // chunks around one, by NeighbourIndex(dx, dy, dz)
+    enum { NEIGHBOUR_COUNT = 27, SELF = 13 };
+
     struct Node
     {
         std::unique_ptr<BlockCube>  sceneInfo;
-        size_t                      rendererIndex;
+        int                         slot;       // renderer pool slot, or ResidencyManager::NONE
+        bool                        isQueued;   // in m_dirtyQueue
+        bool                        isSlotless; // in m_slotless
+        int                         bx, by, bz; // chunk coordinate
+        std::unique_ptr<MeshTask>   task;       // not null: out on a worker
+        Node *                      neighbours[NEIGHBOUR_COUNT];    // nullptr: no chunk, [SELF]: this
+
+        Node() : slot(ResidencyManager::NONE), isQueued(false), isSlotless(false), bx(0), by(0), bz(0), neighbours() {}
+    };
+
+    enum : size_t
+    {
+        DEFAULT_GPU_BUDGET  = 256 * 1024 * 1024,
+        MAX_POOL_SIZE       = 4096,
+        MESHING_PER_THREAD  = 4,            // tasks in flight, keeps workers fed
+        POOL_SLACK          = 64,           // unused slots kept before shrinking
+        VIEW_BLOCKS         = 1000,         // the camera's far plane
+    };
+    // The world map: a ChunkMapT index of Node pointers, the Nodes owned
+    // apart so they never move. Neighbour links, cursors, the dirty queue
+    // and mesh tasks hold Node pointers for the life of the system, so
+    // there is no Erase: unloading chunks needs an unlink and cursor
+    // reset path first.
+    class NodeMap
+    {
+    public:
+        typedef std::vector<std::unique_ptr<Node>> NodeArray;
+
+        Node *              Find(int bx, int by, int bz)
+        {
+            Node * const * p = m_index.Find(bx, by, bz);
+            return p ? *p : nullptr;
+        }
+        const Node *        Find(int bx, int by, int bz) const
+        {
+            Node * const * p = m_index.Find(bx, by, bz);
+            return p ? *p : nullptr;
+        }
+        Node &              FindOrInsert(int bx, int by, int bz, bool * pInserted)
+        {
+            *pInserted = false;
+            if (Node * u = Find(bx, by, bz))
+                return *u;
+
+            // room in the owner first: a throwing insert leaves neither
+            // an orphan Node nor an index entry without one
+            std::unique_ptr<Node> u(new Node());
+            if (m_nodes.size() == m_nodes.capacity())
+            {
+                m_nodes.reserve(m_nodes.size() * 2 + 16);
+            }
+            m_index.FindOrInsert(bx, by, bz) = u.get();
+            m_nodes.push_back(std::move(u));
+            *pInserted = true;
+            return *m_nodes.back();
+        }
+
+        size_t              Size() const { return m_nodes.size(); }
+
+        // creation order
+        NodeArray::const_iterator   begin() const { return m_nodes.cbegin(); }
+        NodeArray::const_iterator   end() const { return m_nodes.cend(); }
+
+    private:
+        ChunkMapT<Node *>   m_index;
+        NodeArray           m_nodes;
+    };
+
+    // min-heap entry by squared chunk distance to the camera chunk
+    struct DirtyRecord
+    {
+        int64_t distance;
+        int     bx, by, bz;
+        Node *  p;
+
+        static bool Farther(const DirtyRecord & r0, const DirtyRecord & r1)
+        {
+            return r0.distance > r1.distance;
+        }
+    };
+    struct ChunkCoord
+    {
+        int bx, by, bz;
+    };
+    // chunk lookup kept for the next one, see Seek
+    template <typename N>
+    struct ChunkCursorT
+    {
+        int         bx, by, bz;
+        N *         u;          // nullptr: no chunk while m_nBlockCube was nChunk
+        size_t      nChunk;
+        bool        isValid;
     };
-    typedef std::map<int, std::map<int, std::map<int, Node>>> NodeTree;
 
+    const uint64_t                  m_id;       // unique per system, see Query
     render::PooledCubeRenderer *    m_renderer;
-    NodeTree                        m_worldTree;
+    NodeMap                         m_worldMap;
     size_t                          m_nBlockCube;
+    int                             m_blockLo[3];   // blocks of every chunk created, see IsPastChunks
+    int                             m_blockHi[3];
+
+    std::vector<DirtyRecord>        m_dirtyQueue;
+    ChunkCoord                      m_cameraChunk;
+    std::vector<Node *>             m_slotless;     // meshed, no slot, see MarkSlotless
+
+    ResidencyManager                m_residency;
+    BlockMeshMode                   m_meshMode;     // of new chunks
+
+    LockFreeQueueT<MeshTask>        m_meshed;       // filled by workers
+    std::vector<MeshTask *>         m_meshDone;     // taken from m_meshed, not applied yet
+    size_t                          m_nMeshing;
+    size_t                          m_nMaxMeshing;
+
+    // single block Set, called on the main thread only
+    NodeCursor                      m_setCursor;
+
+    // Set(pEdits, nCount) scratch, kept to avoid reallocation per batch
+    std::vector<uint64_t>           m_editKeys;
+    std::vector<uint32_t>           m_editIndices;
+    std::vector<uint32_t>           m_editOrder;
+    std::vector<uint32_t>           m_editScratch;
+
+    // last member: joined first, its tasks point into m_worldMap
+    WorkerPool                      m_workers;
 };
 
 
@@ -326,11 +2484,95 @@ void BlockSystem::Unset(int x, int y, int z)
     return pImpl->Unset(x, y , z);
 }
 
+void BlockSystem::Fill(int x0, int y0, int z0, int x1, int y1, int z1, BlockType t)
+{
+    if (x0 > x1 || y0 > y1 || z0 > z1)
+        return;
+
+    return pImpl->Set({ x0, x1 }, { y0, y1 }, { z0, z1 }, t);
+}
+
+void BlockSystem::Clear(int x0, int y0, int z0, int x1, int y1, int z1)
+{
+    if (x0 > x1 || y0 > y1 || z0 > z1)
+        return;
+
+    return pImpl->Unset({ x0, x1 }, { y0, y1 }, { z0, z1 });
+}
+
+void BlockSystem::ApplyEdits(const BlockEdit * pEdits, size_t nCount)
+{
+    return pImpl->Set(pEdits, nCount);
+}
+
 BlockType BlockSystem::Query(int x, int y, int z) const
 {
     return pImpl->Query(x, y, z);
 }
 
+void BlockSystem::Visit(int x0, int y0, int z0, int x1, int y1, int z1, const BlockRunVisitor & visitor) const
+{
+    if (x0 > x1 || y0 > y1 || z0 > z1)
+        return;
+
+    pImpl->Visit({ x0, x1 }, { y0, y1 }, { z0, z1 }, visitor);
+}
+
+bool BlockSystem::Raycast(float ox, float oy, float oz,
+                          float dx, float dy, float dz,
+                          float maxDistance, BlockRayHit * pHit) const
+{
+    win32::ENSURE_NOT_NULL(pHit);
+
+    return pImpl->Raycast(ox, oy, oz, dx, dy, dz, maxDistance, pHit);
+}
+
+void BlockSystem::Raycast(const BlockRay * pRays, size_t nCount, BlockRayHit * pHits) const
+{
+    if (nCount == 0)
+        return;
+
+    win32::ENSURE_NOT_NULL(pRays);
+    win32::ENSURE_NOT_NULL(pHits);
+
+    pImpl->Raycast(pRays, nCount, pHits);
+}
+
+void BlockSystem::Move(BlockBody * pBodies, size_t nCount) const
+{
+    if (nCount == 0)
+        return;
+
+    win32::ENSURE_NOT_NULL(pBodies);
+
+    pImpl->Move(pBodies, nCount);
+}
+
+void BlockSystem::SetGpuBudget(size_t nBytes)
+{
+    pImpl->SetGpuBudget(nBytes);
+}
+
+BlockResidencyStats BlockSystem::GetResidencyStats() const
+{
+    return pImpl->GetResidencyStats();
+}
+
+void BlockSystem::SetMeshMode(BlockMeshMode mode)
+{
+    pImpl->SetMeshMode(mode);
+}
+
+BlockMeshStats BlockSystem::GetMeshStats() const
+{
+    return pImpl->GetMeshStats();
+}
+
+BlockMemoryStats BlockSystem::GetMemoryStats() const
+{
+    return pImpl->GetMemoryStats();
+}
+
 void BlockSystem::BindRenderer(render::PooledCubeRenderer * pRenderer)
 {
     pImpl->BindRenderer(pRenderer);
@@ -341,4 +2583,9 @@ void BlockSystem::Sync(int cx, int cy, int cz, int nMaxUpdate)
     pImpl->Sync(cx, cy, cz, nMaxUpdate);
 }
 
+void BlockSystem::SyncAll(int cx, int cy, int cz)
+{
+    pImpl->SyncAll(cx, cy, cz);
+}
+
 }
\ No newline at end of file
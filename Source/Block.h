@@ -1,5 +1,8 @@
 #pragma once
 
+#include <cstddef>
+#include <functional>
+
 namespace render
 {
     class PooledCubeRenderer;
@@ -8,10 +11,114 @@ namespace render
 namespace scene
 {
 
+    // Solid types index the renderer's texture array from 1, see CubeRenderer.cpp.
+    // Glass and water draw opaque until there is a blended pass.
     enum BlockType
     {
         EMPTY_BLOCK,
         GRASS_BLOCK,
+        DIRT_BLOCK,
+        SAND_BLOCK,
+        STONE_BLOCK,
+        OAK_WOOD_BLOCK,
+        OAK_LEAF_BLOCK,
+        GLASS_BLOCK,
+        WATER_BLOCK,
+
+        BLOCK_TYPE_COUNT,
+    };
+
+    // A run of blocks along +x, starting at world (x, y, z).
+    // 'types' holds 'count' blocks, or is nullptr when all of them are 'type'.
+    // Only valid during the visitor call.
+    struct BlockRun
+    {
+        int                 x, y, z;
+        int                 count;
+        const BlockType *   types;
+        BlockType           type;
+
+        BlockType   operator [] (int i) const { return types ? types[i] : type; }
+    };
+    typedef std::function<void(const BlockRun &)> BlockRunVisitor;
+
+    // How a chunk is turned into GPU data.
+    enum BlockMeshMode
+    {
+        INSTANCE_MESH,      // one 36-vertex cube instance per exposed block
+        FACE_MESH,          // one quad per visible block face
+        GREEDY_MESH,        // visible faces merged into rectangles per slice
+    };
+
+    struct BlockEdit
+    {
+        int         x, y, z;
+        BlockType   type;
+    };
+
+    // Chunk memory utilization. Slabs are shared by all BlockSystems.
+    struct BlockMemoryStats
+    {
+        size_t      nChunk;
+        size_t      nSlab;
+        size_t      nSlabBytes;     // committed from the OS
+        size_t      nUsedBytes;     // held by live chunks
+    };
+
+    // Renderer pool slots, see ResidencyManager.h
+    struct BlockResidencyStats
+    {
+        size_t      nSlot;          // pool size
+        size_t      nResident;      // chunks holding a slot
+        size_t      nBytes;         // instance bytes of resident chunks
+        size_t      nBudgetBytes;
+        size_t      nEvicted;
+        size_t      nRejected;      // slot requests refused, all residents nearer
+    };
+
+    // Meshes as of the last upload, over all loaded chunks.
+    struct BlockMeshStats
+    {
+        size_t      nChunk;         // chunks with a non-empty mesh
+        size_t      nTriangle;      // drawn triangles, 12 per cube instance
+        size_t      nBytes;         // vertex and instance bytes
+    };
+
+    // First solid block on a ray, see BlockSystem::Raycast.
+    struct BlockRayHit
+    {
+        int         x, y, z;        // hit block
+        int         nx, ny, nz;     // normal of the face the ray entered by, 0 if it starts inside
+        int         px, py, pz;     // block in front of that face, where a placed block goes
+        float       distance;       // to the entered face
+        BlockType   type;           // EMPTY_BLOCK: no hit, batched Raycast only
+    };
+
+    struct BlockRay
+    {
+        float       ox, oy, oz;
+        float       dx, dy, dz;
+        float       maxDistance;
+    };
+
+    // Faces of a moving box stopped by blocks, see BlockSystem::Move.
+    enum BlockContact
+    {
+        CONTACT_NEG_X   = 1 << 0,
+        CONTACT_POS_X   = 1 << 1,
+        CONTACT_NEG_Y   = 1 << 2,
+        CONTACT_POS_Y   = 1 << 3,
+        CONTACT_NEG_Z   = 1 << 4,       // standing on a block
+        CONTACT_POS_Z   = 1 << 5,
+    };
+
+    // Axis-aligned box of a player or entity, in world units.
+    struct BlockBody
+    {
+        float       x, y, z;        // in: center, out: moved center
+        float       hx, hy, hz;     // half size
+        float       dx, dy, dz;     // in: motion wanted, out: motion done
+        int         contacts;       // out: BlockContact bits
     };
 
     class BlockSystem
@@ -22,8 +129,46 @@ namespace scene
 
         void        Set(int x, int y, int z, BlockType t);
         void        Unset(int x, int y, int z);
-        void        Sync(int cx, int cy, int cz, int nMaxUpdate = 3);
+        // inclusive box [x0, x1] x [y0, y1] x [z0, z1]
+        void        Fill(int x0, int y0, int z0, int x1, int y1, int z1, BlockType t);
+        void        Clear(int x0, int y0, int z0, int x1, int y1, int z1);
+        // Apply edits grouped by chunk: one lookup and one dirty mark per chunk.
+        // Edits to the same block apply in order, the last one wins.
+        // Batches too spread out for a 63-bit chunk key, over 2^21 chunks
+        // on each axis, fall back to one Set per edit.
+        void        ApplyEdits(const BlockEdit * pEdits, size_t nCount);
+        // Mesh dirty chunks on worker threads, upload up to nMaxUpdate of
+        // the finished ones. Does not wait for workers.
+        void        Sync(int cx, int cy, int cz, int nMaxUpdate = 8);
+        // Sync until every chunk is meshed and uploaded.
+        void        SyncAll(int cx, int cy, int cz);
         BlockType   Query(int x, int y, int z) const;
+        // Visit inclusive box without copying it out: chunk by chunk,
+        // then rows in chunk storage order (z, y outer, x inner).
+        void        Visit(int x0, int y0, int z0, int x1, int y1, int z1, const BlockRunVisitor & visitor) const;
+        // First solid block on the ray from (ox, oy, oz) along (dx, dy, dz)
+        // within maxDistance, in world units: block (x, y, z) is the unit
+        // cube centered on (x, y, z). Return false if there is none, or
+        // if the origin or maxDistance isn't finite or dir has no length.
+        bool        Raycast(float ox, float oy, float oz,
+                            float dx, float dy, float dz,
+                            float maxDistance, BlockRayHit * pHit) const;
+        // Many rays at once, traced in SIMD packets. pHits[i] is the hit
+        // of pRays[i], type EMPTY_BLOCK if none.
+        void        Raycast(const BlockRay * pRays, size_t nCount, BlockRayHit * pHits) const;
+        // Move bodies by their motion, sliding along blocks: the motion is
+        // swept along z, then x, then y, each cut short at the first solid
+        // block. A body already overlapping blocks can move out of them.
+        void        Move(BlockBody * pBodies, size_t nCount) const;
+
+        BlockMemoryStats GetMemoryStats() const;
+        // GPU bytes for instance buffers, far chunks are evicted past it
+        void        SetGpuBudget(size_t nBytes);
+        BlockResidencyStats GetResidencyStats() const;
+
+        // Mesh mode of all chunks, loaded and future. Chunks re-mesh on Sync.
+        void        SetMeshMode(BlockMeshMode mode);
+        BlockMeshStats GetMeshStats() const;
 
         void        BindRenderer(render::PooledCubeRenderer * pRenderer);
 
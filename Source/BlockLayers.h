@@ -0,0 +1,9 @@
+#ifndef BLOCK_LAYERS_H
+#define BLOCK_LAYERS_H
+
+// Texture array layers of PooledCubeRenderer, one per solid block type:
+// layer t - 1 for scene::BlockType t. Shared with the chunk pixel
+// shaders, so preprocessor only.
+#define BLOCK_LAYER_COUNT 8
+
+#endif
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+
+namespace scene
+{
+    // Bit-interleave helpers, the portable form of pdep/pext with mask 0x09249249.
+
+    // Spread the low 10 bits of v two bits apart.
+    inline uint32_t Spread3(uint32_t v)
+    {
+        v &= 0x000003ff;
+        v = (v | (v << 16)) & 0x030000ff;
+        v = (v | (v << 8))  & 0x0300f00f;
+        v = (v | (v << 4))  & 0x030c30c3;
+        v = (v | (v << 2))  & 0x09249249;
+        return v;
+    }
+    // Inverse of Spread3: gather every third bit of v.
+    inline uint32_t Compact3(uint32_t v)
+    {
+        v &= 0x09249249;
+        v = (v | (v >> 2))  & 0x030c30c3;
+        v = (v | (v >> 4))  & 0x0300f00f;
+        v = (v | (v >> 8))  & 0x030000ff;
+        v = (v | (v >> 16)) & 0x000003ff;
+        return v;
+    }
+
+    // Block index layouts of an L^3 chunk, a policy of BlockCubeT.
+    // * Encode(x, y, z) gives the storage index in [0, L^3), Decode inverts it
+    // * ROW_CONTIGUOUS: runs along x are index ranges, row kernels may use them
+
+    // x fastest, then y, then z
+    template <int L>
+    struct LinearLayoutT
+    {
+        enum { ROW_CONTIGUOUS = 1 };
+
+        static int  Encode(int x, int y, int z)
+        {
+            return (z * L + y) * L + x;
+        }
+        static void Decode(int i, int * px, int * py, int * pz)
+        {
+            *px = i & (L - 1);
+            *py = (i / L) & (L - 1);
+            *pz = i / (L * L);
+        }
+    };
+
+    // Z-order curve, bits of x, y, z interleaved with x lowest.
+    // The 6 neighbours of a block are mostly a few cache lines away,
+    // and an aligned cube of size 2^k is one range of 8^k indices.
+    template <int L>
+    struct MortonLayoutT
+    {
+        static_assert(L >= 2 && L <= 1024 && (L & (L - 1)) == 0, "L must be a power of two <= 1024");
+
+        enum { ROW_CONTIGUOUS = 0 };
+
+        static int  Encode(int x, int y, int z)
+        {
+            return static_cast<int>(Spread3(static_cast<uint32_t>(x))
+                                    | (Spread3(static_cast<uint32_t>(y)) << 1)
+                                    | (Spread3(static_cast<uint32_t>(z)) << 2));
+        }
+        static void Decode(int i, int * px, int * py, int * pz)
+        {
+            uint32_t u = static_cast<uint32_t>(i);
+
+            *px = static_cast<int>(Compact3(u));
+            *py = static_cast<int>(Compact3(u >> 1));
+            *pz = static_cast<int>(Compact3(u >> 2));
+        }
+    };
+
+    // Layout of BlockSystem chunks, Morton order if built with CHUNK_MORTON.
+#ifdef CHUNK_MORTON
+    template <int L> using ChunkLayoutT = MortonLayoutT<L>;
+#else
+    template <int L> using ChunkLayoutT = LinearLayoutT<L>;
+#endif
+}
@@ -0,0 +1,257 @@
+#pragma once
+
+#include "Block.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace scene
+{
+    // Sparse voxel octree over an L^3 chunk.
+    // * a node is either a leaf (whole cube is one type) or 8 children
+    // * children of a node are allocated as a group of 8 consecutive nodes
+    // * homogeneous groups collapse back into a leaf on Set
+    template <int L>
+    class OctreeStorageT
+    {
+        static_assert(L >= 2 && L <= 64 && (L & (L - 1)) == 0, "L must be a power of two <= 64");
+
+    public:
+
+        OctreeStorageT(BlockType t = EMPTY_BLOCK)
+            : m_nodes(1, LEAF | t)
+        {
+        }
+
+        // Operations
+
+        BlockType   Get(int x, int y, int z) const
+        {
+            uint32_t n = m_nodes[0];
+            for (int s = L >> 1; !(n & LEAF); s >>= 1)
+            {
+                n = m_nodes[n + Octant(x, y, z, s)];
+            }
+            return static_cast<BlockType>(n & ~LEAF);
+        }
+        // Return type of the leaf containing (x, y, z), and its size.
+        // The leaf cube starts at (x, y, z) & ~(size - 1).
+        BlockType   Find(int x, int y, int z, int * pSize) const
+        {
+            uint32_t n = m_nodes[0];
+            int      size = L;
+            for (; !(n & LEAF); size >>= 1)
+            {
+                n = m_nodes[n + Octant(x, y, z, size >> 1)];
+            }
+            *pSize = size;
+            return static_cast<BlockType>(n & ~LEAF);
+        }
+        // Return previous type.
+        BlockType   Set(int x, int y, int z, BlockType t)
+        {
+            uint32_t    path[DEPTH];
+            int         depth = 0;
+            uint32_t    i = 0;
+
+            for (int size = L; size > 1; size >>= 1)
+            {
+                uint32_t n = m_nodes[i];
+                if (n & LEAF)
+                {
+                    if (static_cast<BlockType>(n & ~LEAF) == t)
+                        return t;
+
+                    n = AllocGroup(n);
+                    m_nodes[i] = n;
+                }
+                path[depth++] = i;
+                i = n + Octant(x, y, z, size >> 1);
+            }
+
+            BlockType t0 = static_cast<BlockType>(m_nodes[i] & ~LEAF);
+            m_nodes[i] = LEAF | t;
+
+            // collapse homogeneous groups bottom-up
+            while (depth > 0)
+            {
+                uint32_t    p = path[--depth];
+                uint32_t    c = m_nodes[p];
+                uint32_t    n = m_nodes[c];
+
+                if (!(n & LEAF) ||
+                    std::count(&m_nodes[c], &m_nodes[c] + 8, n) != 8)
+                    break;
+
+                m_nodes[p] = n;
+                m_free.push_back(c);
+            }
+
+            return t0;
+        }
+        // Set the inclusive box [x0, x1] x [y0, y1] x [z0, z1] to t.
+        void        Fill(int x0, int y0, int z0, int x1, int y1, int z1, BlockType t)
+        {
+            Box box = { x0, y0, z0, x1, y1, z1 };
+            FillNode(0, 0, 0, 0, L, box, t);
+        }
+
+        // Visit every leaf as f(x, y, z, size, type).
+        // A homogeneous region costs one visit, whatever its size.
+        template <typename F>
+        void        ForEachLeaf(F && f) const
+        {
+            ForEachLeafIn(0, 0, 0, L, f);
+        }
+        // Visit leaves inside the aligned cube of 'size' at (x, y, z),
+        // a larger leaf covering it is clipped to the cube.
+        template <typename F>
+        void        ForEachLeafIn(int x, int y, int z, int size, F && f) const
+        {
+            struct Frame { uint32_t n; int x, y, z, size; };
+
+            uint32_t    n = m_nodes[0];
+            for (int s = L; s > size && !(n & LEAF); s >>= 1)
+            {
+                n = m_nodes[n + Octant(x, y, z, s >> 1)];
+            }
+
+            Frame       stack[DEPTH * 7 + 1];
+            int         top = 0;
+
+            stack[top++] = { n, x, y, z, size };
+            while (top > 0)
+            {
+                Frame fr = stack[--top];
+                if (fr.n & LEAF)
+                {
+                    f(fr.x, fr.y, fr.z, fr.size, static_cast<BlockType>(fr.n & ~LEAF));
+                    continue;
+                }
+
+                int h = fr.size >> 1;
+                for (int o = 7; o >= 0; --o)
+                {
+                    stack[top++] =
+                    {
+                        m_nodes[fr.n + o],
+                        fr.x + ((o & 1) ? h : 0),
+                        fr.y + ((o & 2) ? h : 0),
+                        fr.z + ((o & 4) ? h : 0),
+                        h
+                    };
+                }
+            }
+        }
+
+        // Properties
+
+        size_t      Count(BlockType t) const
+        {
+            size_t n = 0;
+            ForEachLeaf([&n, t] (int, int, int, int size, BlockType u)
+                        {
+                            if (u == t)
+                                n += static_cast<size_t>(size) * size * size;
+                        });
+            return n;
+        }
+        size_t      GetNodeCount() const { return m_nodes.size() - m_free.size() * 8; }
+        size_t      GetMemoryUsage() const
+        {
+            return m_nodes.capacity() * sizeof(uint32_t)
+                + m_free.capacity() * sizeof(uint32_t);
+        }
+
+    private:
+
+        enum : uint32_t { LEAF = 0x80000000u };
+        enum { DEPTH = L <= 2 ? 1 : L <= 4 ? 2 : L <= 8 ? 3 : L <= 16 ? 4 : L <= 32 ? 5 : 6 };
+
+        struct Box
+        {
+            int x0, y0, z0;
+            int x1, y1, z1;
+        };
+
+        void        FillNode(uint32_t i, int x, int y, int z, int size, const Box & b, BlockType t)
+        {
+            if (b.x0 <= x && x + size - 1 <= b.x1 &&
+                b.y0 <= y && y + size - 1 <= b.y1 &&
+                b.z0 <= z && z + size - 1 <= b.z1)
+            {
+                FreeGroups(m_nodes[i]);
+                m_nodes[i] = LEAF | t;
+                return;
+            }
+
+            uint32_t n = m_nodes[i];
+            if (n & LEAF)
+            {
+                if (static_cast<BlockType>(n & ~LEAF) == t)
+                    return;
+
+                n = AllocGroup(n);
+                m_nodes[i] = n;
+            }
+
+            int h = size >> 1;
+            for (int o = 0; o < 8; ++o)
+            {
+                int cx = x + ((o & 1) ? h : 0);
+                int cy = y + ((o & 2) ? h : 0);
+                int cz = z + ((o & 4) ? h : 0);
+
+                if (b.x0 < cx + h && cx <= b.x1 &&
+                    b.y0 < cy + h && cy <= b.y1 &&
+                    b.z0 < cz + h && cz <= b.z1)
+                {
+                    FillNode(n + o, cx, cy, cz, h, b, t);
+                }
+            }
+
+            uint32_t c = m_nodes[n];
+            if ((c & LEAF) && std::count(&m_nodes[n], &m_nodes[n] + 8, c) == 8)
+            {
+                m_nodes[i] = c;
+                m_free.push_back(n);
+            }
+        }
+        // Release the child groups below node value n.
+        void        FreeGroups(uint32_t n)
+        {
+            if (n & LEAF)
+                return;
+
+            for (int o = 0; o < 8; ++o)
+            {
+                FreeGroups(m_nodes[n + o]);
+            }
+            m_free.push_back(n);
+        }
+        static int  Octant(int x, int y, int z, int s)
+        {
+            return ((x & s) != 0) | (((y & s) != 0) << 1) | (((z & s) != 0) << 2);
+        }
+        // 8 children, all equal to n
+        uint32_t    AllocGroup(uint32_t n)
+        {
+            uint32_t c;
+            if (m_free.empty())
+            {
+                c = static_cast<uint32_t>(m_nodes.size());
+                m_nodes.resize(m_nodes.size() + 8);
+            }
+            else
+            {
+                c = m_free.back();
+                m_free.pop_back();
+            }
+            std::fill(&m_nodes[c], &m_nodes[c] + 8, n);
+            return c;
+        }
+
+        std::vector<uint32_t>   m_nodes;
+        std::vector<uint32_t>   m_free;
+    };
+}
\ No newline at end of file
@@ -0,0 +1,348 @@
+#pragma once
+
+#include "Block.h"
+#include "SlabPool.h"
+
+#include <bitset>
+#include <cstdint>
+#include <vector>
+
+namespace scene
+{
+    // Palette + bit-packed index storage for N blocks.
+    // * palette maps a small index to BlockType, with a use count per entry
+    // * indices are packed into 64-bit words, 0/1/2/4/8/16 bits each
+    // * width grows when the palette overflows, never straddles a word
+    // * 0 bits: uniform, all blocks are m_palette[0], no word array
+    // * word arrays come from ChunkMemory slabs, not the heap
+    template <int N>
+    class PaletteStorageT
+    {
+        static_assert(N >= 64 && (N & (N - 1)) == 0, "N must be a power of two >= 64");
+
+    public:
+        typedef std::vector<uint64_t, ChunkAllocatorT<uint64_t>> WordArray;
+
+        PaletteStorageT(BlockType t = EMPTY_BLOCK)
+        {
+            Collapse(t);
+        }
+        PaletteStorageT(const PaletteStorageT & other)
+        {
+            *this = other;
+        }
+        PaletteStorageT & operator = (const PaletteStorageT & other)
+        {
+            WordArray(other.m_words).swap(m_words); // drop old capacity
+            m_palette   = other.m_palette;
+            m_counts    = other.m_counts;
+            m_bitShift  = other.m_bitShift;
+            m_wordShift = other.m_wordShift;
+            m_wordMask  = other.m_wordMask;
+            m_valueMask = other.m_valueMask;
+            m_pWords    = IsUniform() ? ZeroWord() : m_words.data();
+            return *this;
+        }
+
+        // Operations
+
+        // Uniform storage reads the shared zero word with a zero mask,
+        // so there is no branch on the representation.
+        BlockType   Get(int i) const
+        {
+            uint64_t w = m_pWords[i >> m_wordShift];
+            return m_palette[(w >> ((i & m_wordMask) << m_bitShift)) & m_valueMask];
+        }
+        // Return previous type.
+        BlockType   Set(int i, BlockType t)
+        {
+            BlockType t0 = Get(i);
+            if (t0 == t)
+                return t0;
+
+            uint64_t    v       = FindOrAddPalette(t);
+
+            uint64_t &  w       = m_words[i >> m_wordShift];
+            int         shift   = (i & m_wordMask) << m_bitShift;
+            uint64_t    v0      = (w >> shift) & m_valueMask;
+
+            --m_counts[static_cast<size_t>(v0)];
+            ++m_counts[static_cast<size_t>(v)];
+
+            w = (w & ~(m_valueMask << shift)) | (v << shift);
+
+            if (m_counts[static_cast<size_t>(v)] == N)
+            {
+                Collapse(t);
+            }
+
+            return t0;
+        }
+        // Decode blocks [i0, i1) into out, a word at a time.
+        void        Decode(int i0, int i1, BlockType * out) const
+        {
+            if (IsUniform())
+            {
+                std::fill(out, out + (i1 - i0), m_palette[0]);
+                return;
+            }
+
+            int bits = 1 << m_bitShift;
+            for (int i = i0; i < i1; )
+            {
+                uint64_t    w = m_pWords[i >> m_wordShift] >> ((i & m_wordMask) << m_bitShift);
+                int         n = std::min(i1 - i, m_wordMask + 1 - (i & m_wordMask));
+
+                for (int j = 0; j < n; ++j, w >>= bits)
+                {
+                    *out++ = m_palette[static_cast<size_t>(w & m_valueMask)];
+                }
+                i += n;
+            }
+        }
+        // Bit k set if block i0 + k is t, for the n <= 64 blocks from i0,
+        // a word at a time.
+        uint64_t    Match(int i0, int n, BlockType t) const
+        {
+            uint64_t all = ~0ull >> (64 - n);
+            if (IsUniform())
+                return m_palette[0] == t ? all : 0;
+
+            size_t v = 0;
+            while (v < m_palette.size() && !(m_palette[v] == t && m_counts[v] != 0))
+                ++v;
+            if (v == m_palette.size())
+                return 0;
+
+            uint64_t    lowBits = LowBits();
+            uint64_t    bits    = 0;
+            for (int k = 0; k < n; )
+            {
+                int         i = i0 + k;
+                int         f = i & m_wordMask;
+                // fields equal to v are all zero after the xor, fold each
+                // field onto its low bit, then pack the low bits
+                uint64_t    x = m_pWords[i >> m_wordShift] ^ (v * lowBits);
+                for (int s = 1; s < (1 << m_bitShift); s <<= 1)
+                {
+                    x |= x >> s;
+                }
+                x = ~x & lowBits;
+                for (int s = 0; s < m_bitShift; ++s)
+                {
+                    x = PackEvenBits(x);
+                }
+                bits |= (x >> f) << k;
+                k += m_wordMask + 1 - f;
+            }
+            return bits & all;
+        }
+        // Set blocks [i0, i1) to t, a word at a time.
+        void        Fill(int i0, int i1, BlockType t)
+        {
+            if (i0 == 0 && i1 == N)
+            {
+                Collapse(t);
+                return;
+            }
+            if (i0 >= i1 || (IsUniform() && m_palette[0] == t))
+                return;
+
+            uint64_t    v       = FindOrAddPalette(t);
+
+            uint64_t    lowBits = LowBits();
+            int         bits    = 1 << m_bitShift;
+            int         k1      = (i1 - 1) >> m_wordShift;
+
+            for (int k = i0 >> m_wordShift; k <= k1; ++k)
+            {
+                // fields of word k inside [i0, i1)
+                int f0 = std::max(i0 - (k << m_wordShift), 0);
+                int f1 = std::min(i1 - (k << m_wordShift), m_wordMask + 1);
+
+                uint64_t mask   = (f1 - f0 == 64 / bits) ? ~0ull :
+                                  (((1ull << ((f1 - f0) * bits)) - 1) << (f0 * bits));
+                uint64_t low    = mask & lowBits;
+                uint64_t w      = m_words[k];
+
+                if (w == (v * lowBits))
+                {
+                    continue;
+                }
+                for (size_t u = 0; u < m_palette.size(); ++u)
+                {
+                    if (m_counts[u] != 0)
+                        m_counts[u] -= CountZeroFields(w ^ (u * lowBits), low);
+                }
+                m_counts[static_cast<size_t>(v)] += f1 - f0;
+
+                m_words[k] = (w & ~mask) | (v * lowBits & mask);
+            }
+
+            if (m_counts[static_cast<size_t>(v)] == N)
+            {
+                Collapse(t);
+            }
+        }
+
+        // Properties
+
+        bool        IsUniform() const { return m_words.empty(); }
+
+        size_t      Count(BlockType t) const
+        {
+            size_t n = 0;
+            for (size_t v = 0; v < m_palette.size(); ++v)
+            {
+                if (m_palette[v] == t)
+                    n += m_counts[v];
+            }
+            return n;
+        }
+        // Visit f(t, count) per type with blocks.
+        template <typename F>
+        void        ForEachType(F && f) const
+        {
+            for (size_t v = 0; v < m_palette.size(); ++v)
+            {
+                if (m_counts[v] != 0)
+                    f(m_palette[v], static_cast<size_t>(m_counts[v]));
+            }
+        }
+        int         GetBitsPerBlock() const { return IsUniform() ? 0 : (1 << m_bitShift); }
+        size_t      GetMemoryUsage() const
+        {
+            return m_words.capacity() * sizeof(uint64_t)
+                + m_palette.capacity() * sizeof(BlockType)
+                + m_counts.capacity() * sizeof(uint32_t);
+        }
+
+    private:
+
+        // bits per index = 1 << bitShift
+        void        SetWidth(int bitShift)
+        {
+            m_bitShift  = bitShift;
+            m_wordShift = 6 - bitShift;
+            m_wordMask  = (1 << m_wordShift) - 1;
+            m_valueMask = (1ull << (1 << bitShift)) - 1;
+        }
+        // lowest bit of every field
+        uint64_t    LowBits() const
+        {
+            return ~0ull / m_valueMask;
+        }
+        // Even bits of x moved to the low half, bit 2k to bit k.
+        static uint64_t PackEvenBits(uint64_t x)
+        {
+            x &= 0x5555555555555555ull;
+            x = (x | (x >> 1)) & 0x3333333333333333ull;
+            x = (x | (x >> 2)) & 0x0f0f0f0f0f0f0f0full;
+            x = (x | (x >> 4)) & 0x00ff00ff00ff00ffull;
+            x = (x | (x >> 8)) & 0x0000ffff0000ffffull;
+            x = (x | (x >> 16)) & 0x00000000ffffffffull;
+            return x;
+        }
+        // Number of zero fields in x, among fields whose low bit is in 'low'.
+        uint32_t    CountZeroFields(uint64_t x, uint64_t low) const
+        {
+            // fold each field onto its low bit
+            for (int s = 1; s < (1 << m_bitShift); s <<= 1)
+            {
+                x |= x >> s;
+            }
+            return static_cast<uint32_t>(
+                std::bitset<64>(low).count() - std::bitset<64>(x & low).count());
+        }
+        void        SetUniform()
+        {
+            m_bitShift  = 0;
+            m_wordShift = 31;
+            m_wordMask  = 0;
+            m_valueMask = 0;
+        }
+        // Drop the word array, all blocks become t.
+        void        Collapse(BlockType t)
+        {
+            WordArray().swap(m_words);
+            m_palette.assign(1, t);
+            m_counts.assign(1, N);
+
+            SetUniform();
+            m_pWords = ZeroWord();
+        }
+        static const uint64_t * ZeroWord()
+        {
+            static const uint64_t zero = 0;
+            return &zero;
+        }
+        uint64_t    FindOrAddPalette(BlockType t)
+        {
+            size_t free = m_palette.size();
+            for (size_t v = 0; v < m_palette.size(); ++v)
+            {
+                if (m_palette[v] == t)
+                    return v;
+                if (m_counts[v] == 0 && free == m_palette.size())
+                    free = v;
+            }
+
+            if (free != m_palette.size())
+            {
+                m_palette[free] = t;
+                return free;
+            }
+
+            if (m_palette.size() > m_valueMask)
+            {
+                Widen();
+            }
+            m_palette.push_back(t);
+            m_counts.push_back(0);
+            return m_palette.size() - 1;
+        }
+        void        Widen()
+        {
+            if (IsUniform())
+            {
+                // materialize, every block keeps index 0
+                SetWidth(0);
+                m_words.assign(N >> m_wordShift, 0);
+                m_pWords = m_words.data();
+                return;
+            }
+
+            win32::ENSURE_TRUE(m_bitShift < 4);
+
+            int         bitShift    = m_bitShift;
+            int         wordShift   = m_wordShift;
+            int         wordMask    = m_wordMask;
+            uint64_t    valueMask   = m_valueMask;
+
+            WordArray words;
+            words.swap(m_words);
+
+            SetWidth(m_bitShift + 1);
+            m_words.assign(N >> m_wordShift, 0);
+
+            for (int i = 0; i < N; ++i)
+            {
+                uint64_t v = (words[i >> wordShift] >> ((i & wordMask) << bitShift)) & valueMask;
+
+                m_words[i >> m_wordShift] |= v << ((i & m_wordMask) << m_bitShift);
+            }
+            m_pWords = m_words.data();
+        }
+
+        WordArray               m_words;
+        std::vector<BlockType>  m_palette;
+        std::vector<uint32_t>   m_counts;
+
+        const uint64_t *        m_pWords;
+
+        int                     m_bitShift;
+        int                     m_wordShift;
+        int                     m_wordMask;
+        uint64_t                m_valueMask;
+    };
+}
\ No newline at end of file
@@ -0,0 +1,45 @@
+#pragma once
+
+// Chunk edge is 1 << CHUNK_SHIFT blocks: 4, 5, 6 for 16, 32, 64.
+#ifndef CHUNK_SHIFT
+#define CHUNK_SHIFT 6
+#endif
+
+namespace scene
+{
+    // Compile-time chunk geometry. Chunk storage, world <-> chunk
+    // coordinates and sync are all templated on one of these.
+    template <int TShift>
+    struct ChunkGeometryT
+    {
+        static_assert(TShift >= 4 && TShift <= 6, "chunk edge must be 16, 32 or 64");
+
+        enum
+        {
+            SHIFT   = TShift,
+            LENGTH  = 1 << TShift,
+            MASK    = LENGTH - 1,
+            AREA    = LENGTH * LENGTH,
+            VOLUME  = LENGTH * LENGTH * LENGTH,
+
+            // 16^3 sections, the unit of dirty tracking: 1, 8 or 64 per chunk
+            SECTION_SHIFT   = 4,
+            SECTION_LENGTH  = 1 << SECTION_SHIFT,
+            SECTION_AXIS    = LENGTH / SECTION_LENGTH,
+            SECTION_COUNT   = SECTION_AXIS * SECTION_AXIS * SECTION_AXIS,
+        };
+
+        // world coordinate -> chunk coordinate, floors negatives
+        static constexpr int    Chunk(int x) { return x >> SHIFT; }
+        // world coordinate -> coordinate inside its chunk
+        static constexpr int    Local(int x) { return x & MASK; }
+        // chunk coordinate -> world coordinate of its first block
+        static constexpr int    Origin(int b) { return b * LENGTH; }
+        // local coordinate -> section index, x fastest
+        static constexpr int    Section(int lx, int ly, int lz)
+        {
+            return ((lz >> SECTION_SHIFT) * SECTION_AXIS + (ly >> SECTION_SHIFT)) * SECTION_AXIS + (lx >> SECTION_SHIFT);
+        }
+    };
+    typedef ChunkGeometryT<CHUNK_SHIFT> ChunkGeometry;
+}
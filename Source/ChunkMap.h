@@ -0,0 +1,210 @@
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace scene
+{
+    // Open-addressing hash index from chunk coordinate (bx, by, bz) to T.
+    // * linear probing over a power-of-two slot table, load factor <= 1/2
+    // * slots keep the full coordinate, any int chunk coordinate is a key
+    // * keys and values sit inline in two parallel slot arrays, a hit
+    //   reads one key and its value, no pointer chasing
+    // * values move on rehash and Erase(): store a pointer as T where
+    //   values must stay put
+    template <typename T>
+    class ChunkMapT
+    {
+    public:
+        struct Entry
+        {
+            int         bx, by, bz;
+            const T &   value;
+        };
+
+        // Walks the full slots in table order.
+        class const_iterator
+        {
+        public:
+            const_iterator(const ChunkMapT * pMap, size_t i) : m_map(pMap), m_i(pMap->NextFull(i)) {}
+
+            Entry               operator*() const
+            {
+                const Key & k = m_map->m_keys[m_i];
+                return { k.bx, k.by, k.bz, m_map->m_values[m_i] };
+            }
+            const_iterator &    operator++()
+            {
+                m_i = m_map->NextFull(m_i + 1);
+                return *this;
+            }
+            bool                operator!=(const const_iterator & other) const { return m_i != other.m_i; }
+
+        private:
+            const ChunkMapT *   m_map;
+            size_t              m_i;
+        };
+
+        ChunkMapT()
+            : m_keys(MIN_CAPACITY)
+            , m_values(MIN_CAPACITY)
+            , m_size(0)
+            , m_shift(64 - MIN_CAPACITY_LOG2)
+        {
+        }
+
+        // Operations
+
+        T *                 Find(int bx, int by, int bz)
+        {
+            size_t i = FindSlot(bx, by, bz);
+            return i == NPOS ? nullptr : &m_values[i];
+        }
+        const T *           Find(int bx, int by, int bz) const
+        {
+            size_t i = FindSlot(bx, by, bz);
+            return i == NPOS ? nullptr : &m_values[i];
+        }
+        // Return existing value, or insert a default-constructed one.
+        T &                 FindOrInsert(int bx, int by, int bz, bool * pInserted = nullptr)
+        {
+            size_t mask = m_keys.size() - 1;
+            size_t i = Hash(bx, by, bz);
+
+            for (; m_keys[i].isFull; i = (i + 1) & mask)
+            {
+                if (m_keys[i].Is(bx, by, bz))
+                {
+                    if (pInserted) *pInserted = false;
+                    return m_values[i];
+                }
+            }
+
+            if ((m_size + 1) * 2 > m_keys.size())
+            {
+                Rehash(m_keys.size() * 2);
+                for (i = Hash(bx, by, bz), mask = m_keys.size() - 1;
+                     m_keys[i].isFull;
+                     i = (i + 1) & mask);
+            }
+
+            m_keys[i] = Key(bx, by, bz);
+            ++m_size;
+
+            if (pInserted) *pInserted = true;
+            return m_values[i];
+        }
+        bool                Erase(int bx, int by, int bz)
+        {
+            size_t i = FindSlot(bx, by, bz);
+            if (i == NPOS)
+                return false;
+
+            // backward-shift deletion, no tombstones
+            size_t mask = m_keys.size() - 1;
+            for (size_t j = (i + 1) & mask; m_keys[j].isFull; j = (j + 1) & mask)
+            {
+                size_t home = Hash(m_keys[j]);
+                if (((j - home) & mask) >= ((j - i) & mask))
+                {
+                    m_keys[i] = m_keys[j];
+                    m_values[i] = std::move(m_values[j]);
+                    i = j;
+                }
+            }
+            m_keys[i].isFull = false;
+            m_values[i] = T();
+            --m_size;
+
+            return true;
+        }
+
+        // Properties
+
+        size_t              Size() const { return m_size; }
+
+        const_iterator      begin() const { return const_iterator(this, 0); }
+        const_iterator      end() const { return const_iterator(this, m_keys.size()); }
+
+    private:
+
+        enum : size_t { NPOS = ~static_cast<size_t>(0) };
+        enum { MIN_CAPACITY_LOG2 = 6, MIN_CAPACITY = 1 << MIN_CAPACITY_LOG2 };
+
+        struct Key
+        {
+            int         bx, by, bz;
+            bool        isFull;
+
+            Key() : bx(0), by(0), bz(0), isFull(false) {}
+            Key(int x, int y, int z) : bx(x), by(y), bz(z), isFull(true) {}
+
+            bool Is(int x, int y, int z) const
+            {
+                return bx == x && by == y && bz == z;
+            }
+        };
+
+        // 21 bits per axis, hash input only: slots compare full coordinates
+        static uint64_t     PackKey(int bx, int by, int bz)
+        {
+            return (static_cast<uint64_t>(bx) & 0x1fffff)
+                | ((static_cast<uint64_t>(by) & 0x1fffff) << 21)
+                | ((static_cast<uint64_t>(bz) & 0x1fffff) << 42);
+        }
+        // Fibonacci hashing: top bits of key * 2^64/phi, with the bits
+        // above the low 21 of each axis folded into the key
+        size_t              Hash(int bx, int by, int bz) const
+        {
+            uint64_t key = PackKey(bx, by, bz)
+                ^ (PackKey(bx >> 21, by >> 21, bz >> 21) * 0xC2B2AE3D27D4EB4Full);
+            return static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> m_shift);
+        }
+        size_t              Hash(const Key & k) const
+        {
+            return Hash(k.bx, k.by, k.bz);
+        }
+        size_t              FindSlot(int bx, int by, int bz) const
+        {
+            size_t mask = m_keys.size() - 1;
+            for (size_t i = Hash(bx, by, bz); m_keys[i].isFull; i = (i + 1) & mask)
+            {
+                if (m_keys[i].Is(bx, by, bz))
+                    return i;
+            }
+            return NPOS;
+        }
+        size_t              NextFull(size_t i) const
+        {
+            while (i < m_keys.size() && !m_keys[i].isFull) ++i;
+            return i;
+        }
+        void                Rehash(size_t nCapacity)
+        {
+            std::vector<Key>    keys(nCapacity);
+            std::vector<T>      values(nCapacity);
+
+            m_keys.swap(keys);
+            m_values.swap(values);
+            for (m_shift = 64; (static_cast<size_t>(1) << (64 - m_shift)) < nCapacity; --m_shift);
+
+            size_t mask = m_keys.size() - 1;
+            for (size_t j = 0; j < keys.size(); ++j)
+            {
+                if (!keys[j].isFull)
+                    continue;
+
+                size_t i = Hash(keys[j]);
+                while (m_keys[i].isFull) i = (i + 1) & mask;
+                m_keys[i] = keys[j];
+                m_values[i] = std::move(values[j]);
+            }
+        }
+
+        std::vector<Key>    m_keys;
+        std::vector<T>      m_values;
+        size_t              m_size;
+        int                 m_shift;
+    };
+}
@@ -2,6 +2,8 @@
 
 #include "CubeRenderer.h"
 #include "DDSTextureLoader.h"
+#include "Block.h"
+#include "BlockLayers.h"
 
 using namespace win32;
 using namespace dx;
@@ -60,6 +62,28 @@ static const float gCubeVertices[] =
      1.0f, -1.0f,  1.0f, 1.0f  ,  0.5f, 0.0f, 0.0f, 0.0f,
 };
 
+// Texture array layers of PooledCubeRenderer, see BlockLayers.h.
+// Placeholders: only grass has a texture so far, the other types load it
+// too and differ by tint until they get their own DDS files.
+static const struct
+{
+    LPCTSTR             pFileName;
+    DirectX::XMFLOAT4   tint;
+}
+gBlockLayers[] =
+{
+    { STR_GRASS_DDS,    { 1.00f, 1.00f, 1.00f, 1.0f } },    // grass
+    { STR_GRASS_DDS,    { 0.60f, 0.42f, 0.28f, 1.0f } },    // dirt
+    { STR_GRASS_DDS,    { 1.00f, 0.92f, 0.62f, 1.0f } },    // sand
+    { STR_GRASS_DDS,    { 0.55f, 0.55f, 0.55f, 1.0f } },    // stone
+    { STR_GRASS_DDS,    { 0.52f, 0.38f, 0.22f, 1.0f } },    // oak wood
+    { STR_GRASS_DDS,    { 0.35f, 0.75f, 0.30f, 1.0f } },    // oak leaf
+    { STR_GRASS_DDS,    { 0.85f, 0.95f, 1.00f, 1.0f } },    // glass
+    { STR_GRASS_DDS,    { 0.25f, 0.40f, 0.90f, 1.0f } },    // water
+};
+static_assert(ARRAYSIZE(gBlockLayers) == scene::BLOCK_TYPE_COUNT - 1, "a layer per solid block type");
+static_assert(ARRAYSIZE(gBlockLayers) == BLOCK_LAYER_COUNT, "the shaders' tint table has a tint per layer");
+
 void CubeRenderer::Initialize(ID3D11Device * d3dDevice, float aspectRatio)
 {
     UNREFERENCED_PARAMETER(aspectRatio);
@@ -280,7 +304,7 @@ void PooledCubeRenderer::Initialize(ID3D11Device * d3dDevice, float aspectRatio)
     
     // Vertex shader
 
-    LoadCompiledShaderFromFile(STR_CUBEVS_VSO, &m_vertexShaderByteCode);
+    LoadCompiledShaderFromFile(STR_CHUNKCUBEVS_VSO, &m_vertexShaderByteCode);
 
     ENSURE_OK(
         m_d3dDevice->CreateVertexShader(m_vertexShaderByteCode.pBytes,
@@ -294,7 +318,7 @@ void PooledCubeRenderer::Initialize(ID3D11Device * d3dDevice, float aspectRatio)
     {
         { "POSITION",    0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0,  0, D3D11_INPUT_PER_VERTEX_DATA,   0 },
         { "TEXCOORD",    0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 16, D3D11_INPUT_PER_VERTEX_DATA,   0 },
-        { "TRANSLATION", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1,  0, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+        { "TRANSLATION", 0, DXGI_FORMAT_R32_UINT,           1,  0, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
     };
     ENSURE_OK(
         m_d3dDevice->CreateInputLayout(inputElementDescs,
@@ -305,7 +329,7 @@ void PooledCubeRenderer::Initialize(ID3D11Device * d3dDevice, float aspectRatio)
 
     // Pixel shader
 
-    LoadCompiledShaderFromFile(STR_CUBEPS_PSO, &m_pixelShaderByteCode);
+    LoadCompiledShaderFromFile(STR_CHUNKCUBEPS_PSO, &m_pixelShaderByteCode);
 
     ENSURE_OK(
         m_d3dDevice->CreatePixelShader(m_pixelShaderByteCode.pBytes,
@@ -313,14 +337,40 @@ void PooledCubeRenderer::Initialize(ID3D11Device * d3dDevice, float aspectRatio)
                                        nullptr,
                                        &m_d3dPixelShader));
 
-    THROW_IF_FAILED(
-        DirectX::CreateDDSTextureFromFile(m_d3dDevice,
-                                          STR_GRASS_DDS,
-                                          nullptr,
-                                          &m_d3dTextureSRV));
+    // Texture array, one layer per block type
+
+    LPCTSTR             layerFileNames[ARRAYSIZE(gBlockLayers)];
+    DirectX::XMFLOAT4   layerTints[ARRAYSIZE(gBlockLayers)];
+    for (size_t i = 0; i < ARRAYSIZE(gBlockLayers); ++i)
+    {
+        layerFileNames[i]   = gBlockLayers[i].pFileName;
+        layerTints[i]       = gBlockLayers[i].tint;
+    }
+    LoadTextureArrayFromFiles(m_d3dDevice,
+                              m_d3dContext,
+                              layerFileNames,
+                              ARRAYSIZE(layerFileNames),
+                              &m_d3dTextureSRV);
 
     // Constant buffer
-    // set by CameraRenderer
+    // VS slot 0 set by CameraRenderer, slot 1 chunk origin
+    // PS slot 0 layer tints
+
+    CD3D11_BUFFER_DESC blockTypeCBDesc(sizeof(layerTints),
+                                       D3D11_BIND_CONSTANT_BUFFER,
+                                       D3D11_USAGE_IMMUTABLE);
+    D3D11_SUBRESOURCE_DATA blockTypeCBData = { layerTints, 0, 0 };
+    ENSURE_OK(
+        m_d3dDevice->CreateBuffer(&blockTypeCBDesc,
+                                  &blockTypeCBData,
+                                  &m_d3dBlockTypeConstantBuffer));
+
+    CD3D11_BUFFER_DESC chunkCBDesc(sizeof(DirectX::XMFLOAT4),
+                                   D3D11_BIND_CONSTANT_BUFFER);
+    ENSURE_OK(
+        m_d3dDevice->CreateBuffer(&chunkCBDesc,
+                                  nullptr,
+                                  &m_d3dChunkConstantBuffer));
 
     // States
 
@@ -348,6 +398,49 @@ void PooledCubeRenderer::Initialize(ID3D11Device * d3dDevice, float aspectRatio)
         m_d3dDevice->CreateDepthStencilState(&defaultDSDesc,
                                              &m_depthStencilState));
 
+    // Face path: quad index buffer
+
+    std::vector<uint16_t> quadIndices(MAX_QUAD_PER_DRAW * 6);
+    for (size_t q = 0; q < MAX_QUAD_PER_DRAW; ++q)
+    {
+        uint16_t v = static_cast<uint16_t>(q * 4);
+        uint16_t * p = quadIndices.data() + q * 6;
+
+        p[0] = v; p[1] = v + 1; p[2] = v + 2;
+        p[3] = v; p[4] = v + 2; p[5] = v + 3;
+    }
+    m_quadIndexBuffer.reset(new D3DConstantIndexBuffer(m_d3dDevice));
+    m_quadIndexBuffer->Reset(quadIndices.data(),
+                             sizeof(uint16_t) * quadIndices.size());
+
+    // Face path: shaders and input layout
+
+    LoadCompiledShaderFromFile(STR_CHUNKFACEVS_VSO, &m_faceVertexShaderByteCode);
+
+    ENSURE_OK(
+        m_d3dDevice->CreateVertexShader(m_faceVertexShaderByteCode.pBytes,
+                                        m_faceVertexShaderByteCode.nSize,
+                                        nullptr,
+                                        &m_d3dFaceVertexShader));
+
+    D3D11_INPUT_ELEMENT_DESC faceInputElementDescs[] =
+    {
+        { "PACKED",      0, DXGI_FORMAT_R32_UINT,           0,  0, D3D11_INPUT_PER_VERTEX_DATA,   0 },
+    };
+    ENSURE_OK(
+        m_d3dDevice->CreateInputLayout(faceInputElementDescs,
+                                       ARRAYSIZE(faceInputElementDescs),
+                                       m_faceVertexShaderByteCode.pBytes,
+                                       m_faceVertexShaderByteCode.nSize,
+                                       &m_d3dFaceInputLayout));
+
+    LoadCompiledShaderFromFile(STR_CHUNKFACEPS_PSO, &m_facePixelShaderByteCode);
+
+    ENSURE_OK(
+        m_d3dDevice->CreatePixelShader(m_facePixelShaderByteCode.pBytes,
+                                       m_facePixelShaderByteCode.nSize,
+                                       nullptr,
+                                       &m_d3dFacePixelShader));
 }
 
 void PooledCubeRenderer::Update(double milliSeconds)
@@ -359,30 +452,23 @@ void PooledCubeRenderer::Draw(ID3D11DeviceContext * d3dContext)
 {
     m_d3dContext = d3dContext;
 
-    // Set IA stage
-
-    m_d3dContext->IASetPrimitiveTopology(
-        D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-    
-    m_d3dContext->IASetInputLayout(m_d3dInputLayout);
-
-    // Set VS stage
-
-    m_d3dContext->VSSetShader(m_d3dVertexShader,
-                              nullptr,
-                              0);
-
     // Set PS stage
 
-    m_d3dContext->PSSetShader(m_d3dPixelShader,
-                              nullptr,
-                              0);
     m_d3dContext->PSSetSamplers(0,
                                 1,
                                 &m_samplerState);
     m_d3dContext->PSSetShaderResources(0,
                                        1,
                                        &m_d3dTextureSRV);
+    m_d3dContext->PSSetConstantBuffers(0,
+                                       1,
+                                       &m_d3dBlockTypeConstantBuffer);
+
+    // Set VS stage
+
+    m_d3dContext->VSSetConstantBuffers(1,
+                                       1,
+                                       &m_d3dChunkConstantBuffer);
 
     // Set RS stage
 
@@ -394,13 +480,37 @@ void PooledCubeRenderer::Draw(ID3D11DeviceContext * d3dContext)
                                          0);
     // Draw
 
+    DrawInstances();
+    DrawFaces();
+}
+
+void PooledCubeRenderer::DrawInstances()
+{
+    // Set IA stage
+
+    m_d3dContext->IASetPrimitiveTopology(
+        D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    
+    m_d3dContext->IASetInputLayout(m_d3dInputLayout);
+
+    // Set VS, PS stage
+
+    m_d3dContext->VSSetShader(m_d3dVertexShader,
+                              nullptr,
+                              0);
+    m_d3dContext->PSSetShader(m_d3dPixelShader,
+                              nullptr,
+                              0);
+
     for (size_t i = 0; i < m_pool.size(); ++i)
     {
-        if (!m_pool[i].instanceBuffer)
+        if (!m_pool[i].instanceBuffer || m_pool[i].instanceCount == 0)
             continue;
 
+        SetChunkOrigin(m_pool[i].origin);
+
         ID3D11Buffer *  buffers[] = { m_vertexBuffer->Get(), m_pool[i].instanceBuffer->Get() };
-        UINT            strides[] = { sizeof(float) * 4 * 2, sizeof(DirectX::XMFLOAT4) };
+        UINT            strides[] = { sizeof(float) * 4 * 2, sizeof(CubeInstance) };
         UINT            offsets[] = { 0, 0 };
     
         m_d3dContext->IASetVertexBuffers(0, // slot
@@ -411,8 +521,6 @@ void PooledCubeRenderer::Draw(ID3D11DeviceContext * d3dContext)
     
         // TEXTURE type
 
-        m_d3dContext->IASetPrimitiveTopology(
-            D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
         m_d3dContext->DrawInstanced(36,
                                     m_pool[i].instanceCount,
                                     0,
@@ -420,25 +528,163 @@ void PooledCubeRenderer::Draw(ID3D11DeviceContext * d3dContext)
     }
 }
 
-void PooledCubeRenderer::SetInstanceBuffer(size_t nIndex, Type type, std::vector<DirectX::XMFLOAT4> data)
+void PooledCubeRenderer::DrawFaces()
+{
+    // Set IA stage
+
+    m_d3dContext->IASetPrimitiveTopology(
+        D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+    m_d3dContext->IASetInputLayout(m_d3dFaceInputLayout);
+
+    m_d3dContext->IASetIndexBuffer(m_quadIndexBuffer->Get(),
+                                   DXGI_FORMAT_R16_UINT,
+                                   0);
+
+    // Set VS, PS stage
+
+    m_d3dContext->VSSetShader(m_d3dFaceVertexShader,
+                              nullptr,
+                              0);
+    m_d3dContext->PSSetShader(m_d3dFacePixelShader,
+                              nullptr,
+                              0);
+
+    for (size_t i = 0; i < m_pool.size(); ++i)
+    {
+        if (!m_pool[i].faceBuffer || m_pool[i].faceCount == 0)
+            continue;
+
+        SetChunkOrigin(m_pool[i].origin);
+
+        ID3D11Buffer *  buffers[] = { m_pool[i].faceBuffer->Get() };
+        UINT            strides[] = { sizeof(FaceVertex) };
+        UINT            offsets[] = { 0 };
+
+        m_d3dContext->IASetVertexBuffers(0, // slot
+                                         1, // number of buffers
+                                         buffers,
+                                         strides,
+                                         offsets);
+
+        // shared indices cover MAX_QUAD_PER_DRAW quads, rebase the rest
+        for (size_t q = 0; q < m_pool[i].faceCount; q += MAX_QUAD_PER_DRAW)
+        {
+            size_t n = std::min<size_t>(m_pool[i].faceCount - q, MAX_QUAD_PER_DRAW);
+
+            m_d3dContext->DrawIndexed(static_cast<UINT>(n * 6),
+                                      0,
+                                      static_cast<INT>(q * 4));
+        }
+    }
+}
+
+void PooledCubeRenderer::SetChunkOrigin(const DirectX::XMFLOAT4 & origin)
+{
+    m_d3dContext->UpdateSubresource(m_d3dChunkConstantBuffer,
+                                    0,
+                                    nullptr,
+                                    &origin,
+                                    0,
+                                    0);
+}
+
+void PooledCubeRenderer::UpdateInstanceBuffer(size_t nIndex,
+                                              Type type,
+                                              InstanceSlotMap & instances,
+                                              int x, int y, int z)
 {
     ENSURE_TRUE(type == TEXTURE);
     ENSURE_TRUE(nIndex < m_pool.size());
 
-    Ptr<D3DDynamicVertexBuffer> &    instanceBuffer = m_pool[nIndex].instanceBuffer;
+    PerRendererInfo &                   info = m_pool[nIndex];
+    Ptr<D3DPatchableVertexBuffer> &     instanceBuffer = info.instanceBuffer;
 
     if (!instanceBuffer)
     {
-        instanceBuffer.reset(new D3DDynamicVertexBuffer(m_d3dDevice));
+        instanceBuffer.reset(new D3DPatchableVertexBuffer(m_d3dDevice));
+    }
+
+    if (instanceBuffer->Reserve(sizeof(CubeInstance) * instances.Size()) ||
+        info.pSource != &instances)
+    {
+        instances.MarkAllDirty();
+        info.pSource = &instances;
+    }
+
+    ENSURE_NOT_NULL(m_d3dContext);
+    instances.TakeDirtyRanges(&m_ranges);
+    for (const InstanceSlotMap::Range & r : m_ranges)
+    {
+        instanceBuffer->Patch(m_d3dContext,
+                              sizeof(CubeInstance) * r.begin,
+                              instances.Data() + r.begin,
+                              sizeof(CubeInstance) * (r.end - r.begin));
+    }
+
+    info.instanceCount  = instances.Size();
+    info.origin         = DirectX::XMFLOAT4(static_cast<float>(x),
+                                            static_cast<float>(y),
+                                            static_cast<float>(z),
+                                            0.0f);
+
+    // drawn as instances from now on
+    info.faceBuffer.reset();
+    info.faceCount = 0;
+}
+
+void PooledCubeRenderer::UpdateFaceBuffer(size_t nIndex,
+                                          const FaceVertex * pVertices,
+                                          size_t nVertex,
+                                          int x, int y, int z)
+{
+    ENSURE_TRUE(nIndex < m_pool.size());
+    ENSURE_TRUE(nVertex % 4 == 0);
+
+    PerRendererInfo &                   info = m_pool[nIndex];
+    Ptr<D3DPatchableVertexBuffer> &     faceBuffer = info.faceBuffer;
+
+    if (!faceBuffer)
+    {
+        faceBuffer.reset(new D3DPatchableVertexBuffer(m_d3dDevice));
     }
 
-    instanceBuffer->Resize(sizeof(data[0]) * data.size());
-    
     ENSURE_NOT_NULL(m_d3dContext);
-    instanceBuffer->Mutate().Begin(m_d3dContext)
-        .Fill(data.data(), data.size());
+    if (nVertex != 0)
+    {
+        faceBuffer->Reserve(sizeof(FaceVertex) * nVertex);
+        faceBuffer->Patch(m_d3dContext,
+                          0,
+                          pVertices,
+                          sizeof(FaceVertex) * nVertex);
+    }
+
+    info.faceCount  = nVertex / 4;
+    info.origin     = DirectX::XMFLOAT4(static_cast<float>(x),
+                                        static_cast<float>(y),
+                                        static_cast<float>(z),
+                                        0.0f);
+
+    // drawn as faces from now on
+    info.instanceBuffer.reset();
+    info.instanceCount = 0;
+    info.pSource = nullptr;
+}
+
+void PooledCubeRenderer::ReleaseInstanceBuffer(size_t nIndex)
+{
+    ENSURE_TRUE(nIndex < m_pool.size());
+
+    m_pool[nIndex] = PerRendererInfo();
+}
+
+void PooledCubeRenderer::MoveInstanceBuffer(size_t nFrom, size_t nTo)
+{
+    ENSURE_TRUE(nFrom < m_pool.size());
+    ENSURE_TRUE(nTo < m_pool.size());
 
-    m_pool[nIndex].instanceCount = data.size();
+    m_pool[nTo]     = std::move(m_pool[nFrom]);
+    m_pool[nFrom]   = PerRendererInfo();
 }
 
 }
\ No newline at end of file
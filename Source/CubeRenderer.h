@@ -3,6 +3,7 @@
 #include "D3DRenderer.h"
 #include "D3DBuffer.h"
 #include "RendererUtil.h"
+#include "InstanceSlotMap.h"
 
 #include <vector>
 
@@ -59,17 +60,73 @@ namespace render
             MAX_TYPE,
         };
 
+        // Chunk cube instance:
+        // bits 0-17 block x, y, z in [0, 64) relative to the chunk origin,
+        // bits 24-31 block type, bits 18-23 unused.
+        // Block type t samples texture array layer t - 1.
+        typedef uint32_t CubeInstance;
+
+        static CubeInstance PackCubeInstance(int x, int y, int z, int type)
+        {
+            return static_cast<CubeInstance>(x | (y << 6) | (z << 12) | (type << 24));
+        }
+        static void UnpackCubeInstance(CubeInstance c, int * pX, int * pY, int * pZ, int * pType)
+        {
+            *pX     = static_cast<int>(c & 0x3f);
+            *pY     = static_cast<int>((c >> 6) & 0x3f);
+            *pZ     = static_cast<int>((c >> 12) & 0x3f);
+            *pType  = static_cast<int>(c >> 24);
+        }
+
+        typedef InstanceSlotMapT<CubeInstance> InstanceSlotMap;
+
+        // Chunk face vertex, 4 per quad in quad index order:
+        // bits 0-20 corner x, y, z in [0, 64] relative to the chunk origin,
+        // bits 21-23 face (-x, +x, -y, +y, -z, +z), bits 24-31 block type.
+        typedef uint32_t FaceVertex;
+
+        static FaceVertex PackFaceVertex(int x, int y, int z, int face, int type)
+        {
+            return static_cast<FaceVertex>(x | (y << 7) | (z << 14) | (face << 21) | (type << 24));
+        }
+
         PooledCubeRenderer(int nPoolSize);
 
         virtual void    Initialize(ID3D11Device * d3dDevice, float aspectRatio) override;
         virtual void    Update(double milliSeconds) override;
         virtual void    Draw(ID3D11DeviceContext * d3dContext) override;
 
-        void            SetInstanceBuffer(size_t nIndex, Type type, std::vector<DirectX::XMFLOAT4> data);
-
+        // Upload the dirty ranges of 'instances' of a chunk at block (x, y, z)
+        // to pool slot nIndex, everything if the slot was last fed by another map.
+        void            UpdateInstanceBuffer(size_t nIndex,
+                                             Type type,
+                                             InstanceSlotMap & instances,
+                                             int x, int y, int z);
+        // Upload the faces of a chunk at block (x, y, z) to pool slot nIndex,
+        // the slot draws quads instead of cube instances from now on.
+        void            UpdateFaceBuffer(size_t nIndex,
+                                         const FaceVertex * pVertices,
+                                         size_t nVertex,
+                                         int x, int y, int z);
+        // Free the GPU buffers of pool slot nIndex, it draws nothing until updated.
+        void            ReleaseInstanceBuffer(size_t nIndex);
+        // Hand the GPU buffers of slot nFrom to slot nTo, nFrom draws nothing.
+        void            MoveInstanceBuffer(size_t nFrom, size_t nTo);
+
+        // grow or shrink, slots past nPoolSize are released
+        void            SetPoolSize(size_t nPoolSize) { m_pool.resize(nPoolSize); }
         size_t          GetPoolSize() const { return m_pool.size(); }
 
     private:
+        enum
+        {
+            // 16-bit indices address 65536 vertices
+            MAX_QUAD_PER_DRAW   = 16384,
+        };
+
+        void            DrawInstances();
+        void            DrawFaces();
+        void            SetChunkOrigin(const DirectX::XMFLOAT4 & origin);
 
         // shared
         ID3D11Device *                  m_d3dDevice;
@@ -77,7 +134,9 @@ namespace render
 
         Ptr<D3DConstantVertexBuffer>    m_vertexBuffer;
 
+        // layer per block type, and a tint per layer in PS slot 0
         ID3D11ShaderResourceView *      m_d3dTextureSRV;
+        ID3D11Buffer *                  m_d3dBlockTypeConstantBuffer;
 
         ID3D11InputLayout *             m_d3dInputLayout;
         ID3D11VertexShader *            m_d3dVertexShader;
@@ -90,14 +149,33 @@ namespace render
         ID3D11SamplerState *            m_samplerState;
         ID3D11DepthStencilState *       m_depthStencilState;
 
+        // chunk origin in blocks, VS slot 1
+        ID3D11Buffer *                  m_d3dChunkConstantBuffer;
+
+        // face path
+        Ptr<D3DConstantIndexBuffer>     m_quadIndexBuffer;
+
+        ID3D11InputLayout *             m_d3dFaceInputLayout;
+        ID3D11VertexShader *            m_d3dFaceVertexShader;
+        ID3D11PixelShader *             m_d3dFacePixelShader;
+        ShaderByteCode                  m_faceVertexShaderByteCode;
+        ShaderByteCode                  m_facePixelShaderByteCode;
+
         // per renderer
         struct PerRendererInfo
         {
-            Ptr<D3DDynamicVertexBuffer> instanceBuffer;
-            size_t                      instanceCount;
+            Ptr<D3DPatchableVertexBuffer>   instanceBuffer;
+            size_t                          instanceCount;
+            const InstanceSlotMap *         pSource;
+
+            Ptr<D3DPatchableVertexBuffer>   faceBuffer;
+            size_t                          faceCount;
+
+            DirectX::XMFLOAT4               origin;     // of the chunk, either path
 
-            PerRendererInfo() : instanceCount(0) {}
+            PerRendererInfo() : instanceCount(0), pSource(nullptr), faceCount(0), origin(0.0f, 0.0f, 0.0f, 0.0f) {}
         };
+        std::vector<InstanceSlotMap::Range> m_ranges;
         std::vector<PerRendererInfo>    m_pool;
     };
 }
\ No newline at end of file
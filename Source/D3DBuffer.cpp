@@ -118,6 +118,81 @@ D3DDynamicVertexBuffer::Mutator D3DDynamicVertexBuffer::Mutate()
 }
 
 
+D3DPatchableVertexBuffer::D3DPatchableVertexBuffer(ID3D11Device * pDevice)
+    : m_d3dDevice(pDevice)
+    , m_d3dVertexBuffer(nullptr)
+    , m_capacity(0)
+{
+}
+
+D3DPatchableVertexBuffer::~D3DPatchableVertexBuffer()
+{
+    if (m_d3dVertexBuffer)
+    {
+        m_d3dVertexBuffer->Release();
+    }
+}
+
+bool D3DPatchableVertexBuffer::Reserve(size_t nBytes)
+{
+    // round up to exp 2
+    size_t n = 4 * 1024; // start from 4KB
+    while (n < nBytes) n <<= 1;
+    nBytes = n;
+
+    if (m_capacity >= nBytes)
+        return false;
+
+    if (m_d3dVertexBuffer)
+    {
+        m_d3dVertexBuffer->Release();
+    }
+
+    D3D11_BUFFER_DESC vertexBufferDesc;
+    vertexBufferDesc.Usage                  = D3D11_USAGE_DEFAULT;
+    vertexBufferDesc.ByteWidth              = nBytes;
+    vertexBufferDesc.BindFlags              = D3D11_BIND_VERTEX_BUFFER;
+    vertexBufferDesc.CPUAccessFlags         = 0;
+    vertexBufferDesc.MiscFlags              = 0;
+    vertexBufferDesc.StructureByteStride    = 0;
+
+    dx::THROW_IF_FAILED(
+        m_d3dDevice->CreateBuffer(&vertexBufferDesc,
+                                  nullptr,
+                                  &m_d3dVertexBuffer));
+
+    m_capacity = nBytes;
+
+    return true;
+}
+
+void D3DPatchableVertexBuffer::Patch(ID3D11DeviceContext * pContext,
+                                     size_t nOffset,
+                                     const void * pBytes,
+                                     size_t nBytes)
+{
+    ENSURE_NOT_NULL(m_d3dVertexBuffer);
+    ENSURE_NOT_NULL(pBytes);
+    ENSURE_TRUE(nOffset + nBytes <= m_capacity);
+
+    // buffer box: x in bytes, y and z unused
+    D3D11_BOX box;
+    box.left    = static_cast<UINT>(nOffset);
+    box.right   = static_cast<UINT>(nOffset + nBytes);
+    box.top     = 0;
+    box.bottom  = 1;
+    box.front   = 0;
+    box.back    = 1;
+
+    pContext->UpdateSubresource(m_d3dVertexBuffer,
+                                0,
+                                &box,
+                                pBytes,
+                                0,
+                                0);
+}
+
+
 D3DConstantVertexBuffer::D3DConstantVertexBuffer(ID3D11Device * pDevice)
     : m_d3dDevice(pDevice)
     , m_d3dVertexBuffer(nullptr)
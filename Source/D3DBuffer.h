@@ -80,6 +80,34 @@ namespace render
         size_t                  m_capacity;
     };
 
+    // Default-usage vertex buffer, patched in place by byte range.
+    class D3DPatchableVertexBuffer
+    {
+    public:
+        D3DPatchableVertexBuffer(ID3D11Device * pDevice);
+        ~D3DPatchableVertexBuffer();
+
+        // Operations
+
+        // grow to hold nBytes, return true if recreated (all data lost)
+        bool                    Reserve(size_t nBytes);
+        void                    Patch(ID3D11DeviceContext * pContext,
+                                      size_t nOffset,
+                                      const void * pBytes,
+                                      size_t nBytes);
+
+        // Properties
+
+        ID3D11Buffer *          Get() { return m_d3dVertexBuffer; }
+
+    private:
+
+        ID3D11Device *          m_d3dDevice;
+        ID3D11Buffer *          m_d3dVertexBuffer;
+
+        size_t                  m_capacity;
+    };
+
     class D3DConstantIndexBuffer
     {
     public:
@@ -0,0 +1,221 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace render
+{
+    // Dense instance array where each key owns one slot.
+    // * Set appends a new key, or rewrites its slot in place
+    // * Erase moves the last instance into the hole (swap-and-pop)
+    // * slots written since TakeDirtyRanges() come back as merged ranges,
+    //   so an upload costs O(changes), not O(instances)
+    // * no GPU dependency
+    template <typename T>
+    class InstanceSlotMapT
+    {
+    public:
+        struct Range
+        {
+            uint32_t    begin, end;
+        };
+
+        InstanceSlotMapT()
+            : m_table(MIN_CAPACITY)
+            , m_shift(32 - MIN_CAPACITY_LOG2)
+            , m_isAllDirty(false)
+        {
+        }
+
+        // Operations
+
+        // Return true if key is new.
+        bool                Set(uint32_t key, const T & value)
+        {
+            size_t i = FindEntry(key);
+            if (i != NPOS)
+            {
+                m_values[m_table[i].slot] = value;
+                MarkDirty(m_table[i].slot);
+                return false;
+            }
+
+            if ((m_values.size() + 1) * 2 > m_table.size())
+            {
+                Rehash(m_table.size() * 2);
+            }
+
+            uint32_t slot = static_cast<uint32_t>(m_values.size());
+
+            m_keys.push_back(key);
+            m_values.push_back(value);
+            m_table[FindFree(key)] = { key, slot };
+
+            MarkDirty(slot);
+            return true;
+        }
+        // Return false if key is absent.
+        bool                Erase(uint32_t key)
+        {
+            size_t i = FindEntry(key);
+            if (i == NPOS)
+                return false;
+
+            // move the last instance into the hole
+            uint32_t slot = m_table[i].slot;
+            uint32_t last = static_cast<uint32_t>(m_values.size() - 1);
+            if (slot != last)
+            {
+                m_keys[slot]    = m_keys[last];
+                m_values[slot]  = m_values[last];
+                m_table[FindEntry(m_keys[slot])].slot = slot;
+
+                MarkDirty(slot);
+            }
+            m_keys.pop_back();
+            m_values.pop_back();
+
+            // backward-shift deletion, no tombstones
+            size_t mask = m_table.size() - 1;
+            for (size_t j = (i + 1) & mask; m_table[j].key != EMPTY; j = (j + 1) & mask)
+            {
+                size_t home = Hash(m_table[j].key);
+                if (((j - home) & mask) >= ((j - i) & mask))
+                {
+                    m_table[i] = m_table[j];
+                    i = j;
+                }
+            }
+            m_table[i].key = EMPTY;
+
+            return true;
+        }
+        const T *           Find(uint32_t key) const
+        {
+            size_t i = FindEntry(key);
+            return i == NPOS ? nullptr : &m_values[m_table[i].slot];
+        }
+        void                Clear()
+        {
+            m_keys.clear();
+            m_values.clear();
+            m_table.assign(MIN_CAPACITY, Entry());
+            m_shift = 32 - MIN_CAPACITY_LOG2;
+            m_dirty.clear();
+            m_isAllDirty = false;
+        }
+        // Next TakeDirtyRanges() covers every slot, e.g. after the GPU buffer is recreated.
+        void                MarkAllDirty()
+        {
+            m_dirty.clear();
+            m_isAllDirty = true;
+        }
+        // Sorted, disjoint slot ranges written since the last call.
+        // Ranges less than nGap slots apart are merged into one.
+        void                TakeDirtyRanges(std::vector<Range> * pRanges, uint32_t nGap = 16)
+        {
+            pRanges->clear();
+
+            uint32_t size = static_cast<uint32_t>(m_values.size());
+            if (m_isAllDirty)
+            {
+                if (size != 0)
+                    pRanges->push_back({ 0, size });
+            }
+            else
+            {
+                std::sort(m_dirty.begin(), m_dirty.end());
+                for (uint32_t slot : m_dirty)
+                {
+                    if (slot >= size)
+                        break;
+
+                    if (!pRanges->empty() && slot <= pRanges->back().end + nGap)
+                        pRanges->back().end = std::max(pRanges->back().end, slot + 1);
+                    else
+                        pRanges->push_back({ slot, slot + 1 });
+                }
+            }
+
+            m_dirty.clear();
+            m_isAllDirty = false;
+        }
+
+        // Properties
+
+        bool                IsDirty() const { return m_isAllDirty || !m_dirty.empty(); }
+        const T *           Data() const { return m_values.data(); }
+        size_t              Size() const { return m_values.size(); }
+
+    private:
+
+        enum : uint32_t { EMPTY = 0xffffffffu };
+        enum : size_t { NPOS = ~static_cast<size_t>(0) };
+        enum { MIN_CAPACITY_LOG2 = 6, MIN_CAPACITY = 1 << MIN_CAPACITY_LOG2 };
+
+        struct Entry
+        {
+            uint32_t    key;
+            uint32_t    slot;
+
+            Entry() : key(EMPTY), slot(0) {}
+            Entry(uint32_t k, uint32_t s) : key(k), slot(s) {}
+        };
+
+        // Fibonacci hashing: top bits of key * 2^32/phi
+        size_t              Hash(uint32_t key) const
+        {
+            return static_cast<size_t>((key * 0x9E3779B9u) >> m_shift);
+        }
+        size_t              FindEntry(uint32_t key) const
+        {
+            size_t mask = m_table.size() - 1;
+            for (size_t i = Hash(key); m_table[i].key != EMPTY; i = (i + 1) & mask)
+            {
+                if (m_table[i].key == key)
+                    return i;
+            }
+            return NPOS;
+        }
+        size_t              FindFree(uint32_t key) const
+        {
+            size_t mask = m_table.size() - 1;
+            size_t i = Hash(key);
+            while (m_table[i].key != EMPTY) i = (i + 1) & mask;
+            return i;
+        }
+        void                Rehash(size_t nCapacity)
+        {
+            std::vector<Entry> table(nCapacity);
+
+            m_table.swap(table);
+            for (m_shift = 32; (static_cast<size_t>(1) << (32 - m_shift)) < nCapacity; --m_shift);
+
+            for (const Entry & e : table)
+            {
+                if (e.key != EMPTY)
+                    m_table[FindFree(e.key)] = e;
+            }
+        }
+        void                MarkDirty(uint32_t slot)
+        {
+            if (m_isAllDirty)
+                return;
+
+            // more dirty slots than instances: upload all instead
+            if (m_dirty.size() >= m_values.size())
+                MarkAllDirty();
+            else
+                m_dirty.push_back(slot);
+        }
+
+        std::vector<uint32_t>   m_keys;     // key of each slot
+        std::vector<T>          m_values;
+        std::vector<Entry>      m_table;    // key -> slot, linear probing
+        int                     m_shift;
+
+        std::vector<uint32_t>   m_dirty;
+        bool                    m_isAllDirty;
+    };
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+
+namespace scene
+{
+    // Multi-producer single-consumer queue of intrusive nodes, lock-free.
+    // * T has a 'T * pNext' member, owned by the queue while pushed
+    // * Push from any thread, TakeAll from one thread
+    // * TakeAll swaps the whole list out, so there is no ABA problem
+    template <typename T>
+    class LockFreeQueueT
+    {
+    public:
+        LockFreeQueueT()
+            : m_head(nullptr)
+        {
+        }
+
+        LockFreeQueueT(const LockFreeQueueT &) = delete;
+        LockFreeQueueT & operator = (const LockFreeQueueT &) = delete;
+
+        // Operations
+
+        void        Push(T * p)
+        {
+            T * head = m_head.load(std::memory_order_relaxed);
+            do
+            {
+                p->pNext = head;
+            } while (!m_head.compare_exchange_weak(head, p,
+                                                   std::memory_order_release,
+                                                   std::memory_order_relaxed));
+        }
+        // Return every pushed node linked by pNext, oldest first, or nullptr.
+        T *         TakeAll()
+        {
+            T * p = m_head.exchange(nullptr, std::memory_order_acquire);
+
+            // pushed newest first, reverse
+            T * r = nullptr;
+            while (p != nullptr)
+            {
+                T * next = p->pNext;
+                p->pNext = r;
+                r = p;
+                p = next;
+            }
+            return r;
+        }
+
+        // Properties
+
+        bool        IsEmpty() const { return m_head.load(std::memory_order_relaxed) == nullptr; }
+
+    private:
+        std::atomic<T *>    m_head;     // newest
+    };
+}
@@ -2,6 +2,7 @@
 
 #include <strsafe.h>
 #include <sstream>
+#include <vector>
 
 #include "D3DApp.h"
 
@@ -64,13 +65,15 @@ void BuildScene(Scene & scene, MyApplication & app)
 
     app.RegisterRenderer(&scene.pool);
     scene.block.BindRenderer(&scene.pool);
-    for (int i = 0; i < 256 * 1024; ++i)
+    std::vector<scene::BlockEdit> edits(256 * 1024);
+    for (scene::BlockEdit & e : edits)
     {
-        int x = rand() % 512 - 256; // [-256, 255]
-        int y = rand() % 512 - 256; // [-256, 255]
-        int z = rand() % 256 - 128; // [-128, 127]
-        scene.block.Set(x, y, z, scene::GRASS_BLOCK);
+        e.x = rand() % 512 - 256; // [-256, 255]
+        e.y = rand() % 512 - 256; // [-256, 255]
+        e.z = rand() % 256 - 128; // [-128, 127]
+        e.type = static_cast<scene::BlockType>(scene::GRASS_BLOCK + rand() % (scene::BLOCK_TYPE_COUNT - 1));
     }
+    scene.block.ApplyEdits(edits.data(), edits.size());
 
     app.SetUpdateSceneCallback(
         [&](double milliSeconds)
@@ -1,8 +1,10 @@
 #include "pch.h"
 
 #include "RendererUtil.h"
+#include "DDSTextureLoader.h"
 
 using namespace win32;
+using namespace dx;
 
 namespace render
 {
@@ -34,4 +36,73 @@ void LoadCompiledShaderFromFile(const TCHAR * pFileName, ShaderByteCode * pSBC)
     ENSURE_TRUE(nReadSize == pSBC->nSize);
 }
 
+void LoadTextureArrayFromFiles(ID3D11Device * d3dDevice,
+                               ID3D11DeviceContext * d3dContext,
+                               const TCHAR * const * pFileNames,
+                               size_t nCount,
+                               ID3D11ShaderResourceView ** ppSRV)
+{
+    ENSURE_TRUE(nCount > 0);
+
+    ID3D11Texture2D *       d3dArray = nullptr;
+    D3D11_TEXTURE2D_DESC    arrayDesc;
+
+    for (size_t i = 0; i < nCount; ++i)
+    {
+        ID3D11Resource *        d3dResource;
+        ID3D11Texture2D *       d3dTexture;
+        D3D11_TEXTURE2D_DESC    desc;
+
+        THROW_IF_FAILED(
+            DirectX::CreateDDSTextureFromFile(d3dDevice,
+                                              pFileNames[i],
+                                              &d3dResource,
+                                              nullptr));
+        THROW_IF_FAILED(
+            d3dResource->QueryInterface(IID_PPV_ARGS(&d3dTexture)));
+        d3dResource->Release();
+
+        d3dTexture->GetDesc(&desc);
+        ENSURE_TRUE(desc.ArraySize == 1);
+
+        // first layer decides size, format and mips
+        if (!d3dArray)
+        {
+            arrayDesc           = desc;
+            arrayDesc.ArraySize = static_cast<UINT>(nCount);
+            ENSURE_OK(
+                d3dDevice->CreateTexture2D(&arrayDesc,
+                                           nullptr,
+                                           &d3dArray));
+        }
+        ENSURE_TRUE(desc.Width == arrayDesc.Width &&
+                    desc.Height == arrayDesc.Height &&
+                    desc.MipLevels == arrayDesc.MipLevels &&
+                    desc.Format == arrayDesc.Format);
+
+        for (UINT mip = 0; mip < desc.MipLevels; ++mip)
+        {
+            d3dContext->CopySubresourceRegion(d3dArray,
+                                              D3D11CalcSubresource(mip, static_cast<UINT>(i), arrayDesc.MipLevels),
+                                              0, 0, 0,
+                                              d3dTexture,
+                                              mip,
+                                              nullptr);
+        }
+        d3dTexture->Release();
+    }
+
+    CD3D11_SHADER_RESOURCE_VIEW_DESC srvDesc(D3D11_SRV_DIMENSION_TEXTURE2DARRAY,
+                                             arrayDesc.Format,
+                                             0,
+                                             arrayDesc.MipLevels,
+                                             0,
+                                             arrayDesc.ArraySize);
+    ENSURE_OK(
+        d3dDevice->CreateShaderResourceView(d3dArray,
+                                            &srvDesc,
+                                            ppSRV));
+    d3dArray->Release();
+}
+
 }
\ No newline at end of file
@@ -15,4 +15,11 @@ namespace render
     
     extern void     LoadCompiledShaderFromFile(const TCHAR * pFileName, ShaderByteCode * pSBC);
 
+    // Load same-sized DDS textures into the layers of one Texture2DArray, in order.
+    extern void     LoadTextureArrayFromFiles(ID3D11Device * d3dDevice,
+                                              ID3D11DeviceContext * d3dContext,
+                                              const TCHAR * const * pFileNames,
+                                              size_t nCount,
+                                              ID3D11ShaderResourceView ** ppSRV);
+
 }
\ No newline at end of file
@@ -0,0 +1,234 @@
+#include "pch.h"
+
+#include "ResidencyManager.h"
+
+#include <algorithm>
+#include <climits>
+
+using namespace win32;
+
+namespace scene
+{
+
+ResidencyManager::ResidencyManager(size_t nBudgetBytes, size_t nMaxSlot)
+    : m_nMaxSlot(nMaxSlot)
+    , m_nBudgetBytes(nBudgetBytes)
+    , m_nBytes(0)
+    , m_nResident(0)
+    , m_nEvicted(0)
+    , m_nRejected(0)
+    , m_cbx(0)
+    , m_cby(0)
+    , m_cbz(0)
+    , m_clock(0)
+{
+}
+
+void ResidencyManager::Update(int cbx, int cby, int cbz)
+{
+    ++m_clock;
+
+    if (cbx == m_cbx && cby == m_cby && cbz == m_cbz)
+        return;
+
+    m_cbx = cbx;
+    m_cby = cby;
+    m_cbz = cbz;
+
+    // distances changed: re-key every resident
+    m_victims.clear();
+    for (size_t i = 0; i < m_slots.size(); ++i)
+    {
+        if (m_slots[i].pOwner)
+            m_victims.insert(VictimOf(static_cast<int>(i)));
+    }
+}
+
+void ResidencyManager::TouchWithin(int64_t nDistanceSq)
+{
+    // the nearest residents end the eviction order
+    m_touched.clear();
+    for (auto it = m_victims.lower_bound({ nDistanceSq, 0, INT_MIN }); it != m_victims.end(); ++it)
+    {
+        if (it->lastUsed != m_clock)
+            m_touched.push_back(it->nSlot);
+    }
+
+    for (int nSlot : m_touched)
+    {
+        m_victims.erase(VictimOf(nSlot));
+        m_slots[nSlot].lastUsed = m_clock;
+        m_victims.insert(VictimOf(nSlot));
+    }
+}
+
+int ResidencyManager::Acquire(void * pOwner, int bx, int by, int bz, size_t nBytes)
+{
+    ENSURE_NOT_NULL(pOwner);
+
+    Slot    s   = { pOwner, bx, by, bz, nBytes, m_clock };
+    int64_t d   = DistanceSq(s);
+
+    // make room, evicting only chunks farther than this one
+    while ((m_free.empty() && m_slots.size() >= m_nMaxSlot) ||
+           m_nBytes + nBytes > m_nBudgetBytes)
+    {
+        int nVictim = FindVictim();
+        if (nVictim == NONE || DistanceSq(m_slots[nVictim]) <= d)
+        {
+            ++m_nRejected;
+            return NONE;
+        }
+        Evict(nVictim);
+    }
+
+    int nSlot;
+    if (m_free.empty())
+    {
+        nSlot = static_cast<int>(m_slots.size());
+        m_slots.push_back(s);
+    }
+    else
+    {
+        nSlot = m_free.back();
+        m_free.pop_back();
+        m_slots[nSlot] = s;
+    }
+
+    m_victims.insert(VictimOf(nSlot));
+    m_nBytes += nBytes;
+    ++m_nResident;
+
+    return nSlot;
+}
+
+bool ResidencyManager::Touch(int nSlot, size_t nBytes)
+{
+    ENSURE_TRUE(nSlot >= 0 && static_cast<size_t>(nSlot) < m_slots.size());
+    ENSURE_NOT_NULL(m_slots[nSlot].pOwner);
+
+    Slot & s = m_slots[nSlot];
+
+    m_victims.erase(VictimOf(nSlot));
+    m_nBytes    = m_nBytes - s.nBytes + nBytes;
+    s.nBytes    = nBytes;
+    s.lastUsed  = m_clock;
+    m_victims.insert(VictimOf(nSlot));
+
+    while (m_nBytes > m_nBudgetBytes)
+    {
+        int nVictim = FindVictim();
+
+        Evict(nVictim);
+        if (nVictim == nSlot)
+            return false;
+    }
+    return true;
+}
+
+void ResidencyManager::Release(int nSlot)
+{
+    ENSURE_TRUE(nSlot >= 0 && static_cast<size_t>(nSlot) < m_slots.size());
+    ENSURE_NOT_NULL(m_slots[nSlot].pOwner);
+
+    m_victims.erase(VictimOf(nSlot));
+    m_nBytes -= m_slots[nSlot].nBytes;
+    --m_nResident;
+
+    m_slots[nSlot].pOwner = nullptr;
+    m_free.push_back(nSlot);
+}
+
+void ResidencyManager::SetBudget(size_t nBytes)
+{
+    m_nBudgetBytes = nBytes;
+
+    while (m_nBytes > m_nBudgetBytes)
+    {
+        Evict(FindVictim());
+    }
+}
+
+size_t ResidencyManager::Compact()
+{
+    // lowest free slot first
+    std::sort(m_free.begin(), m_free.end());
+
+    size_t nSlot = m_slots.size();
+    size_t nUsed = 0;
+    while (nSlot > 0)
+    {
+        int nFrom = static_cast<int>(nSlot - 1);
+        if (m_slots[nFrom].pOwner)
+        {
+            if (nUsed == m_free.size() || m_free[nUsed] >= nFrom)
+                break;
+
+            int nTo = m_free[nUsed++];
+            m_victims.erase(VictimOf(nFrom));
+            m_slots[nTo] = m_slots[nFrom];
+            m_slots[nFrom].pOwner = nullptr;
+            m_victims.insert(VictimOf(nTo));
+
+            if (m_onMove)
+            {
+                m_onMove(m_slots[nTo].pOwner, nFrom, nTo);
+            }
+        }
+        --nSlot;
+    }
+
+    m_slots.resize(nSlot);
+    m_free.erase(m_free.begin(), m_free.begin() + nUsed);
+    m_free.erase(std::remove_if(m_free.begin(), m_free.end(),
+                                [nSlot] (int i) { return static_cast<size_t>(i) >= nSlot; }),
+                 m_free.end());
+
+    return nSlot;
+}
+
+ResidencyManager::Stats ResidencyManager::GetStats() const
+{
+    Stats stats;
+    stats.nSlot         = m_slots.size();
+    stats.nResident     = m_nResident;
+    stats.nBytes        = m_nBytes;
+    stats.nBudgetBytes  = m_nBudgetBytes;
+    stats.nEvicted      = m_nEvicted;
+    stats.nRejected     = m_nRejected;
+    return stats;
+}
+
+int64_t ResidencyManager::DistanceSq(const Slot & s) const
+{
+    int64_t dx = s.bx - m_cbx, dy = s.by - m_cby, dz = s.bz - m_cbz;
+    return dx * dx + dy * dy + dz * dz;
+}
+
+ResidencyManager::Victim ResidencyManager::VictimOf(int nSlot) const
+{
+    const Slot & s = m_slots[nSlot];
+    return { DistanceSq(s), s.lastUsed, nSlot };
+}
+
+int ResidencyManager::FindVictim() const
+{
+    return m_victims.empty() ? NONE : m_victims.begin()->nSlot;
+}
+
+void ResidencyManager::Evict(int nSlot)
+{
+    ENSURE_TRUE(nSlot != NONE);
+
+    void * pOwner = m_slots[nSlot].pOwner;
+
+    Release(nSlot);
+    ++m_nEvicted;
+
+    if (m_onEvict)
+    {
+        m_onEvict(pOwner, nSlot);
+    }
+}
+
+}
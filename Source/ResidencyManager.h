@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <set>
+#include <vector>
+
+namespace scene
+{
+    // Hands out renderer pool slots to chunks, no GPU dependency.
+    // * slots go to chunks near the camera chunk
+    // * the pool grows until the slot limit or the byte budget is hit
+    // * then the farthest resident chunk is evicted, least recently seen
+    //   first among equals, but never for a chunk farther than itself
+    // * residents are kept in eviction order, re-keyed when the camera
+    //   crosses a chunk boundary
+    // * Compact moves resident slots down so the pool can shrink again
+    class ResidencyManager
+    {
+    public:
+        enum { NONE = -1 };
+
+        struct Stats
+        {
+            size_t  nSlot;          // slots ever created, the pool size
+            size_t  nResident;
+            size_t  nBytes;         // reported by resident chunks
+            size_t  nBudgetBytes;
+            size_t  nEvicted;       // since creation
+            size_t  nRejected;      // since creation
+        };
+
+        // f(pOwner, nSlot): nSlot was taken away from pOwner
+        typedef std::function<void(void * pOwner, int nSlot)> EvictCallback;
+        // f(pOwner, nFrom, nTo): pOwner now holds nTo instead of nFrom
+        typedef std::function<void(void * pOwner, int nFrom, int nTo)> MoveCallback;
+
+        ResidencyManager(size_t nBudgetBytes, size_t nMaxSlot);
+
+        // Operations
+
+        // New camera chunk, also advances the recency clock.
+        void            Update(int cbx, int cby, int cbz);
+        // Mark resident chunks at most sqrt(nDistanceSq) chunks from the
+        // camera chunk seen this frame.
+        void            TouchWithin(int64_t nDistanceSq);
+
+        // Slot for pOwner's chunk at (bx, by, bz) of nBytes, or NONE.
+        int             Acquire(void * pOwner, int bx, int by, int bz, size_t nBytes);
+        // Mark nSlot used this frame with its new size.
+        // Return false if it had to be evicted to stay in budget.
+        bool            Touch(int nSlot, size_t nBytes);
+        void            Release(int nSlot);
+
+        // Evict the farthest chunks until within nBytes.
+        void            SetBudget(size_t nBytes);
+        // Move the highest resident slots into the lowest free ones and
+        // drop the free slots at the end: the slot count becomes the
+        // resident count. Return it.
+        size_t          Compact();
+        void            SetEvictCallback(EvictCallback f) { m_onEvict = f; }
+        void            SetMoveCallback(MoveCallback f) { m_onMove = f; }
+
+        // Properties
+
+        size_t          GetSlotCount() const { return m_slots.size(); }
+        size_t          GetResidentCount() const { return m_nResident; }
+        Stats           GetStats() const;
+
+    private:
+        struct Slot
+        {
+            void *      pOwner;     // nullptr: free
+            int         bx, by, bz;
+            size_t      nBytes;
+            uint64_t    lastUsed;
+        };
+        // Orders residents evicted first before the rest.
+        struct Victim
+        {
+            int64_t     distanceSq;
+            uint64_t    lastUsed;
+            int         nSlot;
+
+            bool operator<(const Victim & other) const
+            {
+                if (distanceSq != other.distanceSq)
+                    return distanceSq > other.distanceSq;
+                if (lastUsed != other.lastUsed)
+                    return lastUsed < other.lastUsed;
+                return nSlot < other.nSlot;
+            }
+        };
+
+        int64_t         DistanceSq(const Slot & s) const;
+        Victim          VictimOf(int nSlot) const;
+        // resident slot to evict first, NONE if empty
+        int             FindVictim() const;
+        void            Evict(int nSlot);
+
+        std::vector<Slot>   m_slots;
+        std::vector<int>    m_free;
+        std::set<Victim>    m_victims;  // residents, keyed by the camera chunk
+        std::vector<int>    m_touched;  // TouchWithin scratch
+
+        size_t              m_nMaxSlot;
+        size_t              m_nBudgetBytes;
+        size_t              m_nBytes;
+        size_t              m_nResident;
+        size_t              m_nEvicted;
+        size_t              m_nRejected;
+
+        int                 m_cbx, m_cby, m_cbz;
+        uint64_t            m_clock;
+
+        EvictCallback       m_onEvict;
+        MoveCallback        m_onMove;
+    };
+}
@@ -0,0 +1,23 @@
+#include "../BlockLayers.h"
+
+struct PS_IN
+{
+    float4 pos : SV_POSITION;
+    float4 tex : TEXCOORD0;
+    nointerpolation uint layer : TEXCOORD1;
+};
+
+cbuffer cbBlockTypes : register(b0)
+{
+    float4 tint[BLOCK_LAYER_COUNT]; // per layer, see gBlockLayers
+};
+
+Texture2DArray texCube;
+SamplerState samCube;
+
+float4 main(PS_IN input) : SV_Target
+{
+    float4 texColor;
+    texColor = texCube.Sample(samCube, float3(input.tex.xy, input.layer));
+    return texColor * tint[input.layer] * 0.5f;
+}
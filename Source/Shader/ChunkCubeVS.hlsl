@@ -0,0 +1,43 @@
+cbuffer cbPerObject : register(b0)
+{
+    float4x4 mvp;
+};
+
+cbuffer cbPerChunk : register(b1)
+{
+    float4 origin; // chunk origin in blocks
+};
+
+struct VS_IN
+{
+    // per vertex
+    float4 pos : POSITION;
+    float4 tex : TEXCOORD;
+    // per instance, see PooledCubeRenderer::CubeInstance
+    uint packed : TRANSLATION;
+};
+
+struct PS_IN
+{
+    float4 pos : SV_POSITION;
+    float4 tex : TEXCOORD0;
+    nointerpolation uint layer : TEXCOORD1;
+};
+
+PS_IN main(VS_IN input)
+{
+    PS_IN output;
+
+    float3 block = float3(input.packed & 0x3f,
+                          (input.packed >> 6) & 0x3f,
+                          (input.packed >> 12) & 0x3f);
+
+    // cube vertices are +-1, block (x, y, z) is the 2-unit cube centered
+    // on 2 * (x, y, z), as in CubeVS
+    float3 world = (origin.xyz + block) * 2.0f + input.pos.xyz;
+    output.pos = mul(float4(world, 1.0f), mvp);
+    output.tex = input.tex;
+    output.layer = (input.packed >> 24) - 1;
+
+    return output;
+}
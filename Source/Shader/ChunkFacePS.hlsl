@@ -0,0 +1,48 @@
+#include "../BlockLayers.h"
+
+struct PS_IN
+{
+    float4 pos : SV_POSITION;
+    float3 block : TEXCOORD0;
+    nointerpolation uint face : TEXCOORD1;
+    nointerpolation uint layer : TEXCOORD2;
+};
+
+cbuffer cbBlockTypes : register(b0)
+{
+    float4 tint[BLOCK_LAYER_COUNT]; // per layer, see gBlockLayers
+};
+
+Texture2DArray texCube;
+SamplerState samCube;
+
+float4 main(PS_IN input) : SV_Target
+{
+    // one texture tile per block face, so merged faces repeat it:
+    // sides use the left half of the texture, top and bottom the right
+    float2 tile;
+    float  u0;
+    if (input.face < 2)
+    {
+        tile = input.block.yz;
+        u0 = 0.0f;
+    }
+    else if (input.face < 4)
+    {
+        tile = input.block.xz;
+        u0 = 0.0f;
+    }
+    else
+    {
+        tile = input.block.xy;
+        u0 = 0.5f;
+    }
+
+    float2 scale = float2(0.5f, -1.0f);
+    float2 uv = float2(u0, 1.0f) + frac(tile) * scale;
+
+    // gradients of the unwrapped coordinates, no seams at tile edges
+    float4 texColor;
+    texColor = texCube.SampleGrad(samCube, float3(uv, input.layer), ddx(tile) * scale, ddy(tile) * scale);
+    return texColor * tint[input.layer] * 0.5f;
+}
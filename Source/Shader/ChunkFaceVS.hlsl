@@ -0,0 +1,41 @@
+cbuffer cbPerObject : register(b0)
+{
+    float4x4 mvp;
+};
+
+cbuffer cbPerChunk : register(b1)
+{
+    float4 origin; // chunk origin in blocks
+};
+
+struct VS_IN
+{
+    // see PooledCubeRenderer::FaceVertex
+    uint packed : PACKED;
+};
+
+struct PS_IN
+{
+    float4 pos : SV_POSITION;
+    float3 block : TEXCOORD0; // position in blocks, integers on block edges
+    nointerpolation uint face : TEXCOORD1;
+    nointerpolation uint layer : TEXCOORD2;
+};
+
+PS_IN main(VS_IN input)
+{
+    PS_IN output;
+
+    float3 corner = float3(input.packed & 0x7f,
+                           (input.packed >> 7) & 0x7f,
+                           (input.packed >> 14) & 0x7f);
+
+    output.block = origin.xyz + corner;
+    // block (x, y, z) is the 2-unit cube centered on 2 * (x, y, z), the
+    // cube the instance path draws
+    output.pos = mul(float4((output.block - 0.5f) * 2.0f, 1.0f), mvp);
+    output.face = (input.packed >> 21) & 0x7;
+    output.layer = (input.packed >> 24) - 1;
+
+    return output;
+}
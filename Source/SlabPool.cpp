@@ -0,0 +1,215 @@
+#include "pch.h"
+
+#include "SlabPool.h"
+
+using namespace win32;
+
+namespace scene
+{
+
+SlabPool::SlabPool(size_t nBlockSize, size_t nSlabSize)
+    : m_blockSize((nBlockSize + sizeof(FreeBlock) - 1) / sizeof(FreeBlock) * sizeof(FreeBlock))
+    , m_slabSize(nSlabSize)
+    , m_useLargePages(false)
+    , m_nLargePageSlab(0)
+    , m_free(nullptr)
+    , m_next(nullptr)
+    , m_end(nullptr)
+    , m_nUsed(0)
+{
+    ENSURE_TRUE(m_blockSize <= m_slabSize);
+}
+
+SlabPool::~SlabPool()
+{
+    for (void * pSlab : m_slabs)
+    {
+        VirtualFree(pSlab, 0, MEM_RELEASE);
+    }
+}
+
+void * SlabPool::Alloc()
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    if (m_free)
+    {
+        FreeBlock * p = m_free;
+        m_free = p->pNext;
+        ++m_nUsed;
+        return p;
+    }
+
+    // Grow throws on failure, count the block only once it is ours
+    if (m_next + m_blockSize > m_end)
+    {
+        Grow();
+    }
+
+    void * p = m_next;
+    m_next += m_blockSize;
+    ++m_nUsed;
+    return p;
+}
+
+void SlabPool::Free(void * p)
+{
+    if (!p)
+        return;
+
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    ENSURE_TRUE(m_nUsed > 0);
+    --m_nUsed;
+
+    FreeBlock * b = static_cast<FreeBlock *>(p);
+    b->pNext = m_free;
+    m_free = b;
+}
+
+void SlabPool::UseLargePages(bool bEnable)
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    m_useLargePages = bEnable;
+}
+
+SlabPool::Stats SlabPool::GetStats() const
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    Stats stats;
+    stats.nSlab             = m_slabs.size();
+    stats.nLargePageSlab    = m_nLargePageSlab;
+    stats.nSlabBytes        = m_slabs.size() * m_slabSize;
+    stats.nUsedBytes        = m_nUsed * m_blockSize;
+    return stats;
+}
+
+void SlabPool::Grow()
+{
+    // room for the slab first, so a failed push_back can't leak it
+    if (m_slabs.size() == m_slabs.capacity())
+    {
+        m_slabs.reserve(m_slabs.size() * 2 + 4);
+    }
+
+    void * pSlab = nullptr;
+
+    size_t nLargePage = GetLargePageMinimum();
+    if (m_useLargePages && nLargePage != 0 && m_slabSize % nLargePage == 0)
+    {
+        pSlab = VirtualAlloc(nullptr,
+                             m_slabSize,
+                             MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES,
+                             PAGE_READWRITE);
+        if (pSlab)
+        {
+            ++m_nLargePageSlab;
+        }
+    }
+    if (!pSlab)
+    {
+        pSlab = VirtualAlloc(nullptr,
+                             m_slabSize,
+                             MEM_RESERVE | MEM_COMMIT,
+                             PAGE_READWRITE);
+    }
+    if (!pSlab)
+    {
+        throw std::bad_alloc();
+    }
+
+    m_slabs.push_back(pSlab);
+    m_next = static_cast<char *>(pSlab);
+    m_end = m_next + m_slabSize;
+}
+
+
+namespace
+{
+    enum
+    {
+        MIN_CLASS_SHIFT     = 6,    // 64B
+        MAX_CLASS_SHIFT     = 19,   // 512KB
+        NUM_CLASS           = MAX_CLASS_SHIFT - MIN_CLASS_SHIFT + 1,
+    };
+
+    const size_t SMALL_SLAB_SIZE = 64 * 1024;
+    const size_t LARGE_SLAB_SIZE = 2 * 1024 * 1024; // one large page on x86/x64
+
+    struct ChunkPools
+    {
+        SlabPool * pools[NUM_CLASS];
+
+        ChunkPools()
+        {
+            for (int k = 0; k < NUM_CLASS; ++k)
+            {
+                size_t nBlockSize = static_cast<size_t>(1) << (MIN_CLASS_SHIFT + k);
+
+                pools[k] = new SlabPool(nBlockSize,
+                                        nBlockSize < SMALL_SLAB_SIZE ? SMALL_SLAB_SIZE : LARGE_SLAB_SIZE);
+            }
+        }
+    };
+
+    // Never destroyed: chunks owned by globals are freed during static destruction.
+    ChunkPools & GetChunkPools()
+    {
+        static ChunkPools * pPools = new ChunkPools;
+        return *pPools;
+    }
+
+    // -1 if nBytes is too large for a pool
+    int ClassOf(size_t nBytes)
+    {
+        int nShift = MIN_CLASS_SHIFT;
+        while ((static_cast<size_t>(1) << nShift) < nBytes)
+        {
+            if (++nShift > MAX_CLASS_SHIFT)
+                return -1;
+        }
+        return nShift - MIN_CLASS_SHIFT;
+    }
+}
+
+void * ChunkMemory::Alloc(size_t nBytes)
+{
+    int k = ClassOf(nBytes);
+    return k < 0 ? ::operator new(nBytes) : GetChunkPools().pools[k]->Alloc();
+}
+
+void ChunkMemory::Free(void * p, size_t nBytes)
+{
+    int k = ClassOf(nBytes);
+    if (k < 0)
+        ::operator delete(p);
+    else
+        GetChunkPools().pools[k]->Free(p);
+}
+
+void ChunkMemory::UseLargePages(bool bEnable)
+{
+    for (SlabPool * pPool : GetChunkPools().pools)
+    {
+        pPool->UseLargePages(bEnable);
+    }
+}
+
+SlabPool::Stats ChunkMemory::GetStats()
+{
+    SlabPool::Stats total = {};
+    for (const SlabPool * pPool : GetChunkPools().pools)
+    {
+        SlabPool::Stats stats = pPool->GetStats();
+
+        total.nSlab             += stats.nSlab;
+        total.nLargePageSlab    += stats.nLargePageSlab;
+        total.nSlabBytes        += stats.nSlabBytes;
+        total.nUsedBytes        += stats.nUsedBytes;
+    }
+    return total;
+}
+
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace scene
+{
+    // Fixed-size blocks carved from page-aligned slabs.
+    // * slabs come straight from the OS, optionally backed by large pages
+    // * freed blocks go on an intrusive free list and are reused first
+    // * slabs are kept until the pool dies, so churn never hits the heap
+    class SlabPool
+    {
+    public:
+        struct Stats
+        {
+            size_t  nSlab;
+            size_t  nLargePageSlab;
+            size_t  nSlabBytes;     // committed from the OS
+            size_t  nUsedBytes;     // handed out
+        };
+
+        SlabPool(size_t nBlockSize, size_t nSlabSize);
+        ~SlabPool();
+
+        SlabPool(const SlabPool &) = delete;
+        SlabPool & operator = (const SlabPool &) = delete;
+
+        // Operations
+
+        void *                  Alloc();
+        void                    Free(void * p);
+
+        // Try large pages for new slabs. Needs SeLockMemoryPrivilege,
+        // falls back to normal pages when the OS refuses.
+        void                    UseLargePages(bool bEnable);
+
+        // Properties
+
+        size_t                  GetBlockSize() const { return m_blockSize; }
+        Stats                   GetStats() const;
+
+    private:
+        struct FreeBlock
+        {
+            FreeBlock * pNext;
+        };
+
+        void                    Grow();
+
+        const size_t            m_blockSize;
+        const size_t            m_slabSize;
+        bool                    m_useLargePages;
+
+        std::vector<void *>     m_slabs;
+        size_t                  m_nLargePageSlab;
+
+        FreeBlock *             m_free;
+        char *                  m_next;     // unused tail of the newest slab
+        char *                  m_end;
+        size_t                  m_nUsed;
+
+        mutable std::mutex      m_lock;
+    };
+
+    // Size-classed slab pools behind all chunk memory: BlockCube objects
+    // and their word arrays. Sizes round up to a power of two from 64B to
+    // 512KB; anything larger goes to the heap.
+    class ChunkMemory
+    {
+    public:
+        static void *           Alloc(size_t nBytes);
+        static void             Free(void * p, size_t nBytes);
+
+        static void             UseLargePages(bool bEnable);
+        static SlabPool::Stats  GetStats();
+    };
+
+    // std allocator over ChunkMemory, for chunk storage containers.
+    template <typename T>
+    struct ChunkAllocatorT
+    {
+        typedef T value_type;
+
+        ChunkAllocatorT() = default;
+        template <typename U>
+        ChunkAllocatorT(const ChunkAllocatorT<U> &) {}
+
+        T *     allocate(size_t n)
+        {
+            return static_cast<T *>(ChunkMemory::Alloc(n * sizeof(T)));
+        }
+        void    deallocate(T * p, size_t n)
+        {
+            ChunkMemory::Free(p, n * sizeof(T));
+        }
+    };
+    template <typename T, typename U>
+    bool operator == (const ChunkAllocatorT<T> &, const ChunkAllocatorT<U> &) { return true; }
+    template <typename T, typename U>
+    bool operator != (const ChunkAllocatorT<T> &, const ChunkAllocatorT<U> &) { return false; }
+}
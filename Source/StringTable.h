@@ -7,6 +7,10 @@ static const LPCTSTR STR_SKYBOX_DDS = TEXT("Resources\\Skybox_blue.dds");
 
 static const LPCTSTR STR_CUBEVS_VSO = TEXT("Shader\\CubeVS.vso");
 static const LPCTSTR STR_CUBEPS_PSO = TEXT("Shader\\CubePS.pso");
+static const LPCTSTR STR_CHUNKCUBEVS_VSO = TEXT("Shader\\ChunkCubeVS.vso");
+static const LPCTSTR STR_CHUNKCUBEPS_PSO = TEXT("Shader\\ChunkCubePS.pso");
+static const LPCTSTR STR_CHUNKFACEVS_VSO = TEXT("Shader\\ChunkFaceVS.vso");
+static const LPCTSTR STR_CHUNKFACEPS_PSO = TEXT("Shader\\ChunkFacePS.pso");
 static const LPCTSTR STR_SKYBOXVS_VSO = TEXT("Shader\\SkyboxVS.vso");
 static const LPCTSTR STR_SKYBOXPS_PSO = TEXT("Shader\\SkyboxPS.pso");
 static const LPCTSTR STR_VERTEXSHADER_VSO = TEXT("Shader\\VertexShader.vso");
@@ -0,0 +1,67 @@
+#include "pch.h"
+
+#include "WorkerPool.h"
+
+namespace scene
+{
+
+WorkerPool::WorkerPool(size_t nThread)
+    : m_isStopping(false)
+{
+    if (nThread == 0)
+    {
+        unsigned nCore = std::thread::hardware_concurrency();
+        nThread = nCore > 1 ? nCore - 1 : 1;
+    }
+
+    m_threads.reserve(nThread);
+    for (size_t i = 0; i < nThread; ++i)
+    {
+        m_threads.emplace_back(&WorkerPool::Run, this);
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_isStopping = true;
+        m_tasks.clear();
+    }
+    m_ready.notify_all();
+
+    for (std::thread & t : m_threads)
+    {
+        t.join();
+    }
+}
+
+void WorkerPool::Submit(Task task)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_tasks.push_back(std::move(task));
+    }
+    m_ready.notify_one();
+}
+
+void WorkerPool::Run()
+{
+    for (;;)
+    {
+        Task task;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_ready.wait(lock, [this] { return m_isStopping || !m_tasks.empty(); });
+
+            if (m_isStopping)
+                return;
+
+            task = std::move(m_tasks.front());
+            m_tasks.pop_front();
+        }
+        task();
+    }
+}
+
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace scene
+{
+    // Fixed set of threads running submitted tasks in FIFO order.
+    // * tasks must not touch state owned by the submitting thread,
+    //   hand results back through e.g. LockFreeQueueT
+    // * destruction drops tasks not yet started and joins the threads
+    class WorkerPool
+    {
+    public:
+        typedef std::function<void()> Task;
+
+        // nThread 0: one per core besides the calling thread, at least one
+        explicit WorkerPool(size_t nThread = 0);
+        ~WorkerPool();
+
+        WorkerPool(const WorkerPool &) = delete;
+        WorkerPool & operator = (const WorkerPool &) = delete;
+
+        // Operations
+
+        void                    Submit(Task task);
+
+        // Properties
+
+        size_t                  GetThreadCount() const { return m_threads.size(); }
+
+    private:
+        void                    Run();
+
+        std::vector<std::thread>    m_threads;
+
+        std::mutex                  m_mutex;
+        std::condition_variable     m_ready;
+        std::deque<Task>            m_tasks;
+        bool                        m_isStopping;
+    };
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+// Timing for the benchmarks.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+
+// Best of nRun calls to f, in milliseconds.
+template <typename F>
+double BestOfMs(int nRun, F && f)
+{
+    double best = 1e30;
+    for (int i = 0; i < nRun; ++i)
+    {
+        auto t0 = std::chrono::steady_clock::now();
+        f();
+        auto t1 = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double, std::milli>(t1 - t0).count());
+    }
+    return best;
+}
+
+// Keep a result alive so the work producing it isn't optimized away.
+inline void Consume(uint64_t v)
+{
+    static volatile uint64_t sink;
+    sink = sink + v;
+}
@@ -0,0 +1,97 @@
+#include "pch.h"
+
+#include "Bench.h"
+#include "ChunkMap.h"
+
+#include <map>
+#include <random>
+#include <vector>
+
+using namespace scene;
+
+// The chunk index ChunkMapT replaced: x, then y, then z.
+template <typename T>
+class NestedMapT
+{
+public:
+    T &         FindOrInsert(int bx, int by, int bz) { return m_tree[bx][by][bz]; }
+    const T *   Find(int bx, int by, int bz) const
+    {
+        auto x = m_tree.find(bx);
+        if (x == m_tree.end())
+            return nullptr;
+        auto y = x->second.find(by);
+        if (y == x->second.end())
+            return nullptr;
+        auto z = y->second.find(bz);
+        return z == y->second.end() ? nullptr : &z->second;
+    }
+
+private:
+    std::map<int, std::map<int, std::map<int, T>>> m_tree;
+};
+
+struct Coord
+{
+    int bx, by, bz;
+};
+
+template <typename M>
+static void Run(const char * name, const std::vector<Coord> & chunks, const std::vector<Coord> & probes)
+{
+    const int RUNS = 7;
+
+    double insertMs = BestOfMs(RUNS, [&]
+    {
+        M m;
+        for (const Coord & c : chunks)
+            m.FindOrInsert(c.bx, c.by, c.bz) = c.bx;
+        Consume(m.Find(0, 0, 0) != nullptr);
+    });
+
+    M m;
+    for (const Coord & c : chunks)
+        m.FindOrInsert(c.bx, c.by, c.bz) = c.bx;
+
+    double findMs = BestOfMs(RUNS, [&]
+    {
+        uint64_t n = 0;
+        for (const Coord & c : probes)
+        {
+            const int * p = m.Find(c.bx, c.by, c.bz);
+            n += p ? *p : 0;
+        }
+        Consume(n);
+    });
+
+    std::printf("  %-12s insert %6.1f ns   find %6.1f ns\n",
+                name,
+                insertMs * 1e6 / chunks.size(),
+                findMs * 1e6 / probes.size());
+}
+
+int main()
+{
+    // a 64 x 64 x 4 world of chunks, half the probes miss it
+    std::vector<Coord> chunks;
+    for (int bz = 0; bz < 4; ++bz)
+        for (int by = -32; by < 32; ++by)
+            for (int bx = -32; bx < 32; ++bx)
+                chunks.push_back({ bx, by, bz });
+
+    std::mt19937 rng(1);
+    std::shuffle(chunks.begin(), chunks.end(), rng);
+
+    std::vector<Coord> probes;
+    for (int i = 0; i < (1 << 20); ++i)
+    {
+        probes.push_back({ static_cast<int>(rng() % 128) - 64,
+                           static_cast<int>(rng() % 64) - 32,
+                           static_cast<int>(rng() % 4) });
+    }
+
+    std::printf("%zu chunks, %zu random lookups, ns per operation\n", chunks.size(), probes.size());
+    Run<NestedMapT<int>>("nested map", chunks, probes);
+    Run<ChunkMapT<int>>("ChunkMapT", chunks, probes);
+    return 0;
+}
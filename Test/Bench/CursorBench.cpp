@@ -0,0 +1,106 @@
+#include "pch.h"
+
+#include "Bench.h"
+#include "Block.h"
+#include "ChunkGeometry.h"
+#include "CubeRenderer.h"
+
+#include <cmath>
+#include <cstdio>
+#include <random>
+
+using namespace scene;
+
+static const int R = 256;
+
+// Terrain with stone scattered through it, 512 x 512.
+static void BuildTerrain(BlockSystem & bs)
+{
+    std::mt19937 rng(3);
+    for (int y = -R; y < R; ++y)
+    for (int x = -R; x < R; ++x)
+    {
+        int h = static_cast<int>(8 * std::sin(x * 0.05) + 8 * std::cos(y * 0.07));
+        bs.Fill(x, y, -64, x, y, h, GRASS_BLOCK);
+    }
+    for (int i = 0; i < 20000; ++i)
+    {
+        bs.Set(static_cast<int>(rng() % (2 * R)) - R, static_cast<int>(rng() % (2 * R)) - R,
+               static_cast<int>(rng() % 40) - 20, STONE_BLOCK);
+    }
+}
+
+// 6-neighbour stencil over z in [z0, z1), as lighting does, ns per Query.
+static double Stencil(const BlockSystem & bs, int z0, int z1)
+{
+    size_t  n = 0, nSolid = 0;
+    double  ms = BestOfMs(3, [&]
+    {
+        n = 0;
+        for (int z = z0; z < z1; ++z)
+        for (int y = -R + 1; y < R - 1; ++y)
+        for (int x = -R + 1; x < R - 1; ++x)
+        {
+            nSolid += (bs.Query(x, y, z) != EMPTY_BLOCK) +
+                      (bs.Query(x - 1, y, z) != EMPTY_BLOCK) + (bs.Query(x + 1, y, z) != EMPTY_BLOCK) +
+                      (bs.Query(x, y - 1, z) != EMPTY_BLOCK) + (bs.Query(x, y + 1, z) != EMPTY_BLOCK) +
+                      (bs.Query(x, y, z - 1) != EMPTY_BLOCK) + (bs.Query(x, y, z + 1) != EMPTY_BLOCK);
+            n += 7;
+        }
+    });
+    Consume(nSolid);
+    return ms * 1e6 / n;
+}
+
+// Columns walked along z, crossing into the chunk above every L blocks.
+static double Column(const BlockSystem & bs)
+{
+    size_t  n = 0, nSolid = 0;
+    double  ms = BestOfMs(3, [&]
+    {
+        n = 0;
+        for (int y = -R + 1; y < R - 1; y += 3)
+        for (int x = -R + 1; x < R - 1; x += 3)
+        for (int z = -64; z < 64; ++z)
+        {
+            nSolid += (bs.Query(x, y, z) != EMPTY_BLOCK) + (bs.Query(x, y, z + 1) != EMPTY_BLOCK) +
+                      (bs.Query(x + 1, y + 1, z - 1) != EMPTY_BLOCK);
+            n += 3;
+        }
+    });
+    Consume(nSolid);
+    return ms * 1e6 / n;
+}
+
+// Single block Set along lines through existing chunks, ns per Set.
+static double SetLines(BlockSystem & bs)
+{
+    size_t  n = 0;
+    double  ms = BestOfMs(3, [&]
+    {
+        n = 0;
+        for (int y = -R; y < R; y += 4)
+        for (int x = -R; x < R; ++x)
+        {
+            bs.Set(x, y, 30 + (x & 7), static_cast<BlockType>(1 + (n & 1)));
+            ++n;
+        }
+    });
+    return ms * 1e6 / n;
+}
+
+int main()
+{
+    render::PooledCubeRenderer  r(1);
+    BlockSystem                 bs;
+    bs.BindRenderer(&r);
+    BuildTerrain(bs);
+    SetLines(bs);
+
+    std::printf("chunk %d, ns per access\n", ChunkGeometry::LENGTH);
+    std::printf("  stencil, terrain   %5.2f\n", Stencil(bs, -24, 24));
+    std::printf("  stencil, air       %5.2f\n", Stencil(bs, 40, 88));
+    std::printf("  z-column walk      %5.2f\n", Column(bs));
+    std::printf("  Set along lines    %5.2f\n", SetLines(bs));
+    return 0;
+}
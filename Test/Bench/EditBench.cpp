@@ -0,0 +1,77 @@
+#include "pch.h"
+
+#include "Bench.h"
+#include "Block.h"
+#include "ChunkGeometry.h"
+#include "CubeRenderer.h"
+
+#include <chrono>
+#include <random>
+#include <vector>
+
+using namespace scene;
+
+// BuildScene's workload: 256K random blocks in a 512 x 512 x 256 box,
+// of nType types from GRASS_BLOCK on.
+static std::vector<BlockEdit> MakeEdits(int nType)
+{
+    std::mt19937            rng(1);
+    std::vector<BlockEdit>  edits(256 * 1024);
+    for (BlockEdit & e : edits)
+    {
+        e.x     = static_cast<int>(rng() % 512) - 256;
+        e.y     = static_cast<int>(rng() % 512) - 256;
+        e.z     = static_cast<int>(rng() % 256) - 128;
+        e.type  = static_cast<BlockType>(GRASS_BLOCK + rng() % nType);
+    }
+    return edits;
+}
+
+// Best time of f on a fresh BlockSystem, construction not counted.
+template <typename F>
+static double BestOnFreshMs(int nRun, F && f)
+{
+    double best = 1e30;
+    for (int i = 0; i < nRun; ++i)
+    {
+        render::PooledCubeRenderer  r(1);
+        BlockSystem                 bs;
+        bs.BindRenderer(&r);
+
+        best = std::min(best, BestOfMs(1, [&] { f(bs); }));
+    }
+    return best;
+}
+
+static void Run(int nType)
+{
+    const std::vector<BlockEdit> edits = MakeEdits(nType);
+
+    double setMs = BestOnFreshMs(5, [&] (BlockSystem & bs)
+    {
+        for (const BlockEdit & e : edits)
+            bs.Set(e.x, e.y, e.z, e.type);
+    });
+    double applyMs = BestOnFreshMs(5, [&] (BlockSystem & bs)
+    {
+        bs.ApplyEdits(edits.data(), edits.size());
+    });
+
+    render::PooledCubeRenderer  r(1);
+    BlockSystem                 bs;
+    bs.BindRenderer(&r);
+    bs.ApplyEdits(edits.data(), edits.size());
+    BlockMemoryStats m = bs.GetMemoryStats();
+
+    std::printf("  %d type(s)   Set %6.1f ms   ApplyEdits %6.1f ms   %zu chunks   slab %.1f MB\n",
+                nType, setMs, applyMs, m.nChunk, m.nSlabBytes / (1024.0 * 1024.0));
+}
+
+int main()
+{
+    std::printf("256K edits, chunk %d\n", ChunkGeometry::LENGTH);
+    Run(1);
+    Run(2);
+    Run(BLOCK_TYPE_COUNT - 1);
+    return 0;
+}
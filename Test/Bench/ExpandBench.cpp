@@ -0,0 +1,130 @@
+#include "pch.h"
+
+#include "Bench.h"
+#include "BitExpand.h"
+#include "Block.h"
+#include "ChunkGeometry.h"
+#include "CubeRenderer.h"
+
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace scene;
+
+static const int L      = ChunkGeometry::LENGTH;
+static const int VOLUME = L * L * L;
+
+// The loop ExpandBits replaced.
+static size_t ShiftLoop(uint64_t bits, uint32_t base, uint32_t * pOut)
+{
+    uint32_t * p = pOut;
+    for (uint32_t i = 0; bits; ++i, bits >>= 1)
+    {
+        if (bits & 1)
+            *p++ = base + i;
+    }
+    return p - pOut;
+}
+
+// Occupancy rows of a chunk, one in 'every' blocks solid.
+static std::vector<uint64_t> MakeRows(int every)
+{
+    std::mt19937            rng(1);
+    std::vector<uint64_t>   rows(L * L, every == 1 ? ~0ull : 0);
+    for (int i = 0; every != 1 && i < VOLUME / every; ++i)
+    {
+        int j = static_cast<int>(rng() % VOLUME);
+        rows[j / L] |= 1ull << (j % L);
+    }
+    return rows;
+}
+
+// Extract every solid block position of a chunk, Gvoxel/s.
+static void RunExpand(const char * name, int every)
+{
+    static const char * NAME[] = { "shift loop", "scalar", "SSE4.1", "AVX2" };
+    const ExpandBitsFunc FUNC[] =
+    {
+        ShiftLoop,
+        GetExpandBits(EXPAND_SCALAR),
+        GetExpandBits(EXPAND_SSE41),
+        GetExpandBits(EXPAND_AVX2),
+    };
+
+    const std::vector<uint64_t> rows = MakeRows(every);
+    std::vector<uint32_t>       out(VOLUME + 64);
+
+    std::printf("%s\n", name);
+    for (int k = 0; k < 4; ++k)
+    {
+        if (!FUNC[k])
+        {
+            std::printf("  %-10s   not supported\n", NAME[k]);
+            continue;
+        }
+
+        const int   nRep = 100;
+        size_t      n = 0;
+        double      ms = BestOfMs(5, [&]
+        {
+            for (int r = 0; r < nRep; ++r)
+            {
+                n = 0;
+                for (int i = 0; i < L * L; ++i)
+                    n += FUNC[k](rows[i], static_cast<uint32_t>(i * L), &out[n]);
+                Consume(out[n / 2]);
+            }
+        });
+        std::printf("  %-10s   %6zu positions   %5.2f Gvoxel/s\n",
+                    NAME[k], n, static_cast<double>(VOLUME) * nRep / ms / 1e6);
+    }
+}
+
+// Re-mesh one chunk through SyncAll, so BeginMesh and the upload count
+// too, Mvoxel/s.
+static void RunMesh(const char * name, int every)
+{
+    static const char * NAME[] = { "instance", "face", "greedy" };
+
+    std::printf("%s, mesh end to end\n", name);
+    for (int mode = INSTANCE_MESH; mode <= GREEDY_MESH; ++mode)
+    {
+        render::PooledCubeRenderer  r(1);
+        BlockSystem                 bs;
+        bs.BindRenderer(&r);
+
+        std::mt19937 rng(1);
+        if (every == 1)
+            bs.Fill(0, 0, 0, L - 1, L - 1, L - 1, GRASS_BLOCK);
+        for (int i = 0; every != 1 && i < VOLUME / every; ++i)
+        {
+            int x = static_cast<int>(rng() % L), y = static_cast<int>(rng() % L), z = static_cast<int>(rng() % L);
+            bs.Set(x, y, z, static_cast<BlockType>(GRASS_BLOCK + rng() % 4));
+        }
+        bs.SetMeshMode(static_cast<BlockMeshMode>(mode));
+        bs.SyncAll(0, 0, 0);
+
+        // a mode change drops the mesh, the next Sync builds it again
+        BlockMeshMode other = static_cast<BlockMeshMode>((mode + 1) % 3);
+        double ms = 1e30;
+        for (int r = 0; r < 20; ++r)
+        {
+            bs.SetMeshMode(other);
+            bs.SetMeshMode(static_cast<BlockMeshMode>(mode));
+            ms = std::min(ms, BestOfMs(1, [&] { bs.SyncAll(0, 0, 0); }));
+        }
+        std::printf("  %-10s   %8zu triangles   %7.1f Mvoxel/s\n",
+                    NAME[mode], bs.GetMeshStats().nTriangle, VOLUME / ms / 1e3);
+    }
+}
+
+int main()
+{
+    std::printf("chunk %d, best ExpandBits %d\n", L, static_cast<int>(ExpandBitsBestIsa));
+    RunExpand("full chunk", 1);
+    RunExpand("sparse chunk, 5%", 20);
+    RunMesh("full chunk", 1);
+    RunMesh("sparse chunk, 5%", 20);
+    return 0;
+}
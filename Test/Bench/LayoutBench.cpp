@@ -0,0 +1,118 @@
+#include "pch.h"
+
+#include "Bench.h"
+#include "Block.h"
+#include "ChunkGeometry.h"
+#include "CubeRenderer.h"
+
+#include <random>
+#include <vector>
+
+using namespace scene;
+
+// Built once per layout: LayoutBench against linear chunks,
+// LayoutBenchMorton against Morton ordered ones, see BlockLayout.h.
+// The kernels read blocks through BlockSystem, so through BlockCubeT.
+
+static const int L = ChunkGeometry::LENGTH;
+
+// Visible faces between solid and empty neighbours, inner blocks only.
+static uint64_t CountFaces(const BlockSystem & bs)
+{
+    uint64_t n = 0;
+    for (int z = 1; z < L - 1; ++z)
+    for (int y = 1; y < L - 1; ++y)
+    for (int x = 1; x < L - 1; ++x)
+    {
+        if (bs.Query(x, y, z) == EMPTY_BLOCK)
+            continue;
+        n += (bs.Query(x - 1, y, z) == EMPTY_BLOCK) + (bs.Query(x + 1, y, z) == EMPTY_BLOCK)
+           + (bs.Query(x, y - 1, z) == EMPTY_BLOCK) + (bs.Query(x, y + 1, z) == EMPTY_BLOCK)
+           + (bs.Query(x, y, z - 1) == EMPTY_BLOCK) + (bs.Query(x, y, z + 1) == EMPTY_BLOCK);
+    }
+    return n;
+}
+
+// Empty blocks reachable from the chunk's corner, 6-connected, as a
+// light flood does.
+static uint64_t FloodFill(const BlockSystem & bs, std::vector<int> & queue, std::vector<uint8_t> & seen)
+{
+    static const int STEP[6][3] = { { -1, 0, 0 }, { 1, 0, 0 }, { 0, -1, 0 }, { 0, 1, 0 }, { 0, 0, -1 }, { 0, 0, 1 } };
+
+    queue.clear();
+    std::fill(seen.begin(), seen.end(), 0);
+    queue.push_back(0);
+    seen[0] = 1;
+    for (size_t head = 0; head < queue.size(); ++head)
+    {
+        int i = queue[head];
+        int x = i % L, y = i / L % L, z = i / (L * L);
+        for (const int * s : STEP)
+        {
+            int nx = x + s[0], ny = y + s[1], nz = z + s[2];
+            if (nx < 0 || nx >= L || ny < 0 || ny >= L || nz < 0 || nz >= L)
+                continue;
+
+            int j = (nz * L + ny) * L + nx;
+            if (seen[j] || bs.Query(nx, ny, nz) != EMPTY_BLOCK)
+                continue;
+            seen[j] = 1;
+            queue.push_back(j);
+        }
+    }
+    return queue.size();
+}
+
+// Ambient occlusion of top faces: the 8 blocks around the one above.
+static uint64_t OccludeTops(const BlockSystem & bs)
+{
+    uint64_t n = 0;
+    for (int z = 1; z < L - 2; ++z)
+    for (int y = 1; y < L - 1; ++y)
+    for (int x = 1; x < L - 1; ++x)
+    {
+        if (bs.Query(x, y, z) == EMPTY_BLOCK || bs.Query(x, y, z + 1) != EMPTY_BLOCK)
+            continue;
+        for (int dy = -1; dy <= 1; ++dy)
+        for (int dx = -1; dx <= 1; ++dx)
+        {
+            if (dx || dy)
+                n += bs.Query(x + dx, y + dy, z + 1) != EMPTY_BLOCK;
+        }
+    }
+    return n;
+}
+
+int main()
+{
+    render::PooledCubeRenderer  r(1);
+    BlockSystem                 bs;
+    bs.BindRenderer(&r);
+
+    // about 30% dense
+    std::mt19937 rng(3);
+    for (int i = 0; i < L * L * L * 36 / 100; ++i)
+    {
+        bs.Set(rng() % L, rng() % L, rng() % L, static_cast<BlockType>(1 + rng() % 2));
+    }
+
+    std::vector<int>        queue;
+    std::vector<uint8_t>    seen(L * L * L);
+    uint64_t                nFace = 0, nFlood = 0, nOccluded = 0;
+
+    double faceMs   = BestOfMs(7, [&] { nFace = CountFaces(bs); });
+    double floodMs  = BestOfMs(7, [&] { nFlood = FloodFill(bs, queue, seen); });
+    double aoMs     = BestOfMs(7, [&] { nOccluded = OccludeTops(bs); });
+    Consume(nFace + nFlood + nOccluded);
+
+#ifdef CHUNK_MORTON
+    const char * name = "morton";
+#else
+    const char * name = "linear";
+#endif
+    std::printf("neighbour kernels over a 30%% dense %d^3 chunk, %s layout\n", L, name);
+    std::printf("  face count   %6.2f ms   %llu faces\n", faceMs, static_cast<unsigned long long>(nFace));
+    std::printf("  flood fill   %6.2f ms   %llu blocks\n", floodMs, static_cast<unsigned long long>(nFlood));
+    std::printf("  top face AO  %6.2f ms   %llu occluders\n", aoMs, static_cast<unsigned long long>(nOccluded));
+    return 0;
+}
@@ -0,0 +1,86 @@
+#include "pch.h"
+
+#include "Bench.h"
+#include "Block.h"
+#include "ChunkGeometry.h"
+#include "CubeRenderer.h"
+
+#include <cmath>
+#include <cstdio>
+
+using namespace scene;
+
+static const int L = ChunkGeometry::LENGTH;
+
+static size_t UsedBytes(const BlockSystem & bs)
+{
+    return bs.GetMemoryStats().nUsedBytes;
+}
+
+// Slab bytes one chunk adds after SyncAll, per chunk content.
+static void RunChunk(BlockMeshMode mode)
+{
+    render::PooledCubeRenderer  r(1);
+    BlockSystem                 bs;
+    bs.BindRenderer(&r);
+    bs.SetMeshMode(mode);
+
+    size_t u0 = UsedBytes(bs);
+    bs.Set(5, 5, 5, GRASS_BLOCK);
+    bs.SyncAll(0, 0, 0);
+
+    size_t u1 = UsedBytes(bs);
+    bs.Fill(4 * L, 0, 0, 5 * L - 1, L - 1, L - 1, GRASS_BLOCK);
+    bs.SyncAll(0, 0, 0);
+
+    // two types, two thirds solid
+    size_t u2 = UsedBytes(bs);
+    for (int z = 0; z < L; ++z)
+    for (int y = 0; y < L; ++y)
+    for (int x = 0; x < L; ++x)
+    {
+        if ((x + y + z) % 3 != 0)
+            bs.Set(8 * L + x, y, z, (x & 8) ? GRASS_BLOCK : static_cast<BlockType>(GRASS_BLOCK + 1));
+    }
+    bs.SyncAll(0, 0, 0);
+    size_t u3 = UsedBytes(bs);
+
+    static const char * NAME[] = { "instance", "face", "greedy" };
+    std::printf("  %-8s   one block %6.1f KB   uniform full %6.1f KB   dense, two types %6.1f KB\n",
+                NAME[mode], (u1 - u0) / 1024.0, (u2 - u1) / 1024.0, (u3 - u2) / 1024.0);
+}
+
+// Instances of a 512 x 512 heightmap against one per solid block.
+static void RunHeightmap()
+{
+    render::PooledCubeRenderer  r(1);
+    BlockSystem                 bs;
+    bs.BindRenderer(&r);
+    bs.SetGpuBudget(size_t(1) << 32);
+
+    size_t nSolid = 0;
+    for (int y = -256; y < 256; ++y)
+    for (int x = -256; x < 256; ++x)
+    {
+        int h = 32 + static_cast<int>(12.0 * std::sin(x / 23.0) + 12.0 * std::cos(y / 17.0));
+        bs.Fill(x, y, 0, x, y, h, GRASS_BLOCK);
+        nSolid += h + 1;
+    }
+
+    double ms = BestOfMs(1, [&] { bs.SyncAll(0, 0, 0); });
+    size_t nInstance = bs.GetMeshStats().nTriangle / 12;
+
+    std::printf("  heightmap   %.1fM solid   %.2fM instances   %.1fx fewer   SyncAll %.0f ms   slab %.1f MB\n",
+                nSolid / 1e6, nInstance / 1e6, static_cast<double>(nSolid) / nInstance, ms,
+                bs.GetMemoryStats().nSlabBytes / (1024.0 * 1024.0));
+}
+
+int main()
+{
+    std::printf("chunk memory after SyncAll, chunk %d\n", L);
+    RunChunk(INSTANCE_MESH);
+    RunChunk(FACE_MESH);
+    RunChunk(GREEDY_MESH);
+    RunHeightmap();
+    return 0;
+}
@@ -0,0 +1,77 @@
+#include "pch.h"
+
+#include "Bench.h"
+#include "Block.h"
+#include "CubeRenderer.h"
+
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <random>
+
+using namespace scene;
+
+// Flat ground, 512 x 512 x 16.
+static void FlatWorld(BlockSystem & bs)
+{
+    bs.Fill(-256, -256, 0, 255, 255, 15, GRASS_BLOCK);
+}
+
+// Noisy heightmap, 512 x 512.
+static void NoisyWorld(BlockSystem & bs)
+{
+    std::mt19937 rng(7);
+    for (int x = -256; x < 256; ++x)
+    for (int y = -256; y < 256; ++y)
+    {
+        int h = static_cast<int>(24 + 10 * std::sin(x * 0.05) * std::cos(y * 0.07) + 4 * std::sin(x * 0.31 + y * 0.17));
+        bs.Fill(x, y, 0, x, y, h + static_cast<int>(rng() % 3), GRASS_BLOCK);
+    }
+}
+
+// 2M random blocks in 256 x 256 x 64.
+static void RandomWorld(BlockSystem & bs)
+{
+    std::mt19937            rng(7);
+    std::vector<BlockEdit>  edits(2 * 1024 * 1024);
+    for (BlockEdit & e : edits)
+    {
+        e.x     = static_cast<int>(rng() % 256) - 128;
+        e.y     = static_cast<int>(rng() % 256) - 128;
+        e.z     = static_cast<int>(rng() % 64);
+        e.type  = GRASS_BLOCK;
+    }
+    bs.ApplyEdits(edits.data(), edits.size());
+}
+
+static void Run(const char * name, const std::function<void(BlockSystem &)> & build)
+{
+    static const char * MODE[] = { "instance", "face", "greedy" };
+
+    std::printf("%s\n", name);
+    for (int mode = INSTANCE_MESH; mode <= GREEDY_MESH; ++mode)
+    {
+        render::PooledCubeRenderer  r(1);
+        BlockSystem                 bs;
+        bs.BindRenderer(&r);
+        bs.SetGpuBudget(size_t(1) << 32);
+        bs.SetMeshMode(static_cast<BlockMeshMode>(mode));
+        build(bs);
+
+        double          ms = BestOfMs(1, [&] { bs.SyncAll(0, 0, 0); });
+        BlockMeshStats  s = bs.GetMeshStats();
+
+        std::printf("  %-8s   %9zu triangles   %8.0f / chunk   %7.2f KB / chunk   SyncAll %4.0f ms\n",
+                    MODE[mode], s.nTriangle,
+                    static_cast<double>(s.nTriangle) / s.nChunk,
+                    s.nBytes / 1024.0 / s.nChunk, ms);
+    }
+}
+
+int main()
+{
+    Run("flat 512 x 512 x 16", FlatWorld);
+    Run("noisy heightmap 512 x 512", NoisyWorld);
+    Run("random 2M in 256 x 256 x 64", RandomWorld);
+    return 0;
+}
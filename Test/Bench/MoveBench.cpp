@@ -0,0 +1,116 @@
+#include "pch.h"
+
+#include "Bench.h"
+#include "Block.h"
+#include "ChunkGeometry.h"
+#include "CubeRenderer.h"
+#include "MoveReference.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace scene;
+
+static const int N = 4096;  // bodies
+static const int T = 200;   // ticks
+
+// Terrain of four types, 400 x 400, with pillars and loose blocks.
+static void BuildTerrain(BlockSystem & bs, std::mt19937 & rng)
+{
+    const int R = 200;
+    for (int x = -R; x < R; ++x)
+    for (int y = -R; y < R; ++y)
+    {
+        int h = static_cast<int>(6 * std::sin(x * 0.05f) + 6 * std::cos(y * 0.07f));
+        bs.Fill(x, y, -40, x, y, h, static_cast<BlockType>(1 + ((x ^ y) & 3)));
+    }
+    for (int i = 0; i < 400; ++i)
+    {
+        int x = static_cast<int>(rng() % (2 * R)) - R, y = static_cast<int>(rng() % (2 * R)) - R;
+        bs.Fill(x, y, -10, x + rng() % 3, y + rng() % 3, 20, STONE_BLOCK);
+    }
+    for (int i = 0; i < 3000; ++i)
+    {
+        bs.Set(static_cast<int>(rng() % (2 * R)) - R, static_cast<int>(rng() % (2 * R)) - R,
+               static_cast<int>(rng() % 30), DIRT_BLOCK);
+    }
+}
+
+// T ticks of bodies running 0.5 block a tick and falling, M body-moves/s
+// of the best of 3 runs.
+template <typename F>
+static double Run(const std::vector<BlockBody> & start,
+                  const std::vector<float> & mx, const std::vector<float> & my, F && move)
+{
+    double best = 1e30;
+    for (int run = 0; run < 3; ++run)
+    {
+        std::vector<BlockBody>  bodies = start;
+        std::vector<float>      vz(N, 0);
+        double                  ms = 0;
+        for (int tick = 0; tick < T; ++tick)
+        {
+            for (int i = 0; i < N; ++i)
+            {
+                vz[i] -= 0.05f;
+                bodies[i].dx = mx[tick * N + i];
+                bodies[i].dy = my[tick * N + i];
+                bodies[i].dz = vz[i];
+            }
+            ms += BestOfMs(1, [&] { move(bodies.data()); });
+            for (int i = 0; i < N; ++i)
+            {
+                if (bodies[i].contacts & (CONTACT_NEG_Z | CONTACT_POS_Z))
+                    vz[i] = 0;
+            }
+        }
+        best = std::min(best, ms);
+    }
+    return static_cast<double>(N) * T / best / 1e3;
+}
+
+int main()
+{
+    std::mt19937                            rng(3);
+    std::uniform_real_distribution<float>   u(-1, 1);
+
+    render::PooledCubeRenderer  r(1);
+    BlockSystem                 bs;
+    bs.BindRenderer(&r);
+    bs.SetGpuBudget(size_t(1) << 31);
+    BuildTerrain(bs, rng);
+
+    // one in 4 bodies is wider and taller, motion made up front
+    std::vector<BlockBody>  start(N);
+    std::vector<float>      mx(N * T), my(N * T);
+    for (int i = 0; i < N; ++i)
+    {
+        float hxy = i % 4 == 0 ? 0.7f : 0.3f;
+        float hz  = i % 4 == 0 ? 1.0f : 0.9f;
+        start[i] = { u(rng) * 180, u(rng) * 180, 60 + 10 * u(rng), hxy, hxy, hz, 0, 0, 0, 0 };
+
+        float angle = u(rng) * 3.14159f;
+        for (int t = 0; t < T; ++t)
+        {
+            angle += u(rng) * 0.3f;
+            mx[t * N + i] = 0.5f * std::cos(angle);
+            my[t * N + i] = 0.5f * std::sin(angle);
+        }
+    }
+
+    std::printf("%d bodies, %d ticks, chunk %d, M body-moves/s\n", N, T, ChunkGeometry::LENGTH);
+    for (int isMeshed = 0; isMeshed < 2; ++isMeshed)
+    {
+        // meshing turns some chunks into octrees
+        if (isMeshed)
+            bs.SyncAll(0, 0, 0);
+
+        double rows  = Run(start, mx, my, [&] (BlockBody * p) { bs.Move(p, N); });
+        double query = Run(start, mx, my, [&] (BlockBody * p) { MoveByQuery(bs, p, N); });
+        std::printf("  %-10s   Move %5.2f   Query per cell %5.2f\n", isMeshed ? "meshed" : "unmeshed", rows, query);
+    }
+    return 0;
+}
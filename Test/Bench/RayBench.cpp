@@ -0,0 +1,107 @@
+#include "pch.h"
+
+#include "Bench.h"
+#include "Block.h"
+#include "CubeRenderer.h"
+
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace scene;
+
+// Boxes and scattered blocks within 200 of the origin, a hollow shell.
+static void BuildScattered(BlockSystem & bs, std::mt19937 & rng)
+{
+    for (int i = 0; i < 60; ++i)
+    {
+        int x = static_cast<int>(rng() % 400) - 200;
+        int y = static_cast<int>(rng() % 400) - 200;
+        int z = static_cast<int>(rng() % 400) - 200;
+        bs.Fill(x, y, z, x + rng() % 20, y + rng() % 20, z + rng() % 20, static_cast<BlockType>(1 + rng() % 4));
+    }
+    for (int i = 0; i < 3000; ++i)
+    {
+        bs.Set(static_cast<int>(rng() % 400) - 200, static_cast<int>(rng() % 400) - 200,
+               static_cast<int>(rng() % 400) - 200, static_cast<BlockType>(1 + rng() % 4));
+    }
+    for (int i = 0; i < 4000; ++i)
+    {
+        bs.Set(static_cast<int>(rng() % 120) - 60, static_cast<int>(rng() % 120) - 60,
+               static_cast<int>(rng() % 120) - 60, static_cast<BlockType>(1 + rng() % 4));
+    }
+    bs.Clear(-3, -3, -3, 3, 3, 3);
+    bs.Fill(100, 100, 100, 200, 200, 200, STONE_BLOCK);
+    bs.Clear(101, 101, 101, 199, 199, 199);
+}
+
+// Rolling ground of four types, 512 x 512.
+static void BuildTerrain(BlockSystem & bs)
+{
+    for (int x = -256; x < 256; ++x)
+    for (int y = -256; y < 256; ++y)
+    {
+        int h = static_cast<int>(8 * std::sin(x * 0.05f) + 8 * std::cos(y * 0.07f));
+        bs.Fill(x, y, -64, x, y, h, static_cast<BlockType>(1 + (x * y & 3)));
+    }
+}
+
+// Single rays one by one, then the same rays in packets, Mrays/s.
+static void Run(const char * name, const BlockSystem & bs, const std::vector<BlockRay> & rays)
+{
+    std::vector<BlockRayHit> hits(rays.size());
+
+    int     nHit = 0;
+    double  singleMs = BestOfMs(3, [&]
+    {
+        nHit = 0;
+        for (const BlockRay & r : rays)
+            nHit += bs.Raycast(r.ox, r.oy, r.oz, r.dx, r.dy, r.dz, r.maxDistance, &hits[0]);
+    });
+    double  packetMs = BestOfMs(3, [&] { bs.Raycast(rays.data(), rays.size(), hits.data()); });
+
+    std::printf("  %-24s   single %5.2f   packets %5.2f Mrays/s   %6d hits\n",
+                name, rays.size() / singleMs / 1e3, rays.size() / packetMs / 1e3, nHit);
+}
+
+int main()
+{
+    const size_t                            N = 256 * 1024;
+    std::mt19937                            rng(7);
+    std::uniform_real_distribution<float>   u(-1, 1);
+    std::vector<BlockRay>                   rays(N);
+
+    std::printf("%zu rays, one thread\n", N);
+    {
+        render::PooledCubeRenderer  r(1);
+        BlockSystem                 bs;
+        bs.BindRenderer(&r);
+        BuildScattered(bs, rng);
+        bs.SyncAll(0, 0, 0);
+
+        for (BlockRay & ray : rays)
+            ray = { 0, 0, 0, u(rng), u(rng), u(rng), 300 };
+        Run("300 blocks from origin", bs, rays);
+
+        for (BlockRay & ray : rays)
+            ray = { u(rng) * 300, u(rng) * 300, u(rng) * 300, u(rng), u(rng), u(rng), 64 };
+        Run("64 blocks, scattered", bs, rays);
+    }
+    {
+        // unmeshed as on a server, then meshed: meshing turns chunks of
+        // one block into octrees
+        render::PooledCubeRenderer  r(1);
+        BlockSystem                 bs;
+        bs.BindRenderer(&r);
+        bs.SetGpuBudget(size_t(1) << 31);
+        BuildTerrain(bs);
+
+        for (BlockRay & ray : rays)
+            ray = { u(rng) * 250, u(rng) * 250, 20 + 10 * u(rng), u(rng), u(rng), u(rng) * 0.3f, 200 };
+        Run("200 over terrain", bs, rays);
+        bs.SyncAll(0, 0, 0);
+        Run("200 over terrain, meshed", bs, rays);
+    }
+    return 0;
+}
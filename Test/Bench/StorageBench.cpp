@@ -0,0 +1,68 @@
+#include "pch.h"
+
+#include "Bench.h"
+#include "BlockOctree.h"
+#include "BlockStorage.h"
+
+#include <cmath>
+#include <random>
+
+using namespace scene;
+
+static const int L = 64;
+static const int N = L * L * L;
+
+// Memory and Get time of the flat and octree backends on one chunk.
+template <typename F>
+static void Run(const char * name, F && typeAt)
+{
+    OctreeStorageT<L>   octree;
+    PaletteStorageT<N>  flat;
+
+    for (int z = 0; z < L; ++z)
+        for (int y = 0; y < L; ++y)
+            for (int x = 0; x < L; ++x)
+            {
+                BlockType t = typeAt(x, y, z);
+                if (t != EMPTY_BLOCK)
+                {
+                    octree.Set(x, y, z, t);
+                    flat.Set((z * L + y) * L + x, t);
+                }
+            }
+
+    double octreeMs = BestOfMs(7, [&]
+    {
+        uint64_t n = 0;
+        for (int i = 0; i < N; ++i)
+            n += octree.Get(i % L, (i / L) % L, i / (L * L));
+        Consume(n);
+    });
+    double flatMs = BestOfMs(7, [&]
+    {
+        uint64_t n = 0;
+        for (int i = 0; i < N; ++i)
+            n += flat.Get(i);
+        Consume(n);
+    });
+
+    std::printf("  %-16s octree %8zu B %6.2f ns/Get   flat %8zu B %6.2f ns/Get\n",
+                name,
+                octree.GetMemoryUsage(), octreeMs * 1e6 / N,
+                flat.GetMemoryUsage(), flatMs * 1e6 / N);
+}
+
+int main()
+{
+    std::mt19937 rng(5);
+
+    std::printf("one %d^3 chunk, bytes and Get in storage order\n", L);
+    Run("dense (2 types)", [&] (int, int, int) { return static_cast<BlockType>(1 + rng() % 2); });
+    Run("sparse (~13)", [&] (int, int, int) { return rng() % 20000 == 0 ? GRASS_BLOCK : EMPTY_BLOCK; });
+    Run("terrain", [&] (int x, int y, int z)
+    {
+        int h = 20 + static_cast<int>(8 * std::sin(x * 0.1) * std::cos(y * 0.13));
+        return z < h ? GRASS_BLOCK : EMPTY_BLOCK;
+    });
+    return 0;
+}
@@ -0,0 +1,94 @@
+#include "pch.h"
+
+#include "BitExpand.h"
+#include "Check.h"
+
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace scene;
+
+// Words from empty to full, sparse words take another path.
+static std::vector<uint64_t> MakeWords()
+{
+    std::vector<uint64_t> words = { 0, ~0ull, 1, 1ull << 63, 0x8000000000000001ull, 0xff, 0xff00000000000000ull };
+    for (int i = 0; i < 64; ++i)
+    {
+        words.push_back(1ull << i);
+        words.push_back(~(1ull << i));
+    }
+
+    std::mt19937_64 rng(5);
+    for (int density = 1; density < 64; density += 3)
+    for (int i = 0; i < 200; ++i)
+    {
+        uint64_t w = 0;
+        for (int b = 0; b < 64; ++b)
+        {
+            if (static_cast<int>(rng() % 64) < density)
+                w |= 1ull << b;
+        }
+        words.push_back(w);
+    }
+    return words;
+}
+
+// The scalar version writes base + i for each set bit i.
+static void TestScalar(const std::vector<uint64_t> & words)
+{
+    ExpandBitsFunc scalar = GetExpandBits(EXPAND_SCALAR);
+    CHECK(scalar != nullptr);
+
+    uint32_t out[64];
+    for (uint64_t w : words)
+    {
+        size_t n = scalar(w, 1000, out);
+        CHECK(n == static_cast<size_t>(PopCount(w)));
+
+        size_t k = 0;
+        for (uint32_t i = 0; i < 64; ++i)
+        {
+            if (w & (1ull << i))
+                CHECK(k < n && out[k++] == 1000 + i);
+        }
+    }
+}
+
+// SSE4.1 and AVX2, where the CPU runs them, match the scalar version.
+static void TestSimd(const std::vector<uint64_t> & words)
+{
+    ExpandBitsFunc scalar = GetExpandBits(EXPAND_SCALAR);
+    for (ExpandBitsIsa isa : { EXPAND_SSE41, EXPAND_AVX2 })
+    {
+        ExpandBitsFunc simd = GetExpandBits(isa);
+        if (!simd)
+        {
+            std::printf("isa %d not supported, skipped\n", static_cast<int>(isa));
+            continue;
+        }
+        for (uint64_t w : words)
+        for (uint32_t base : { 0u, 77u, 0xfffffff0u })
+        {
+            uint32_t a[64], b[64];
+            size_t   na = scalar(w, base, a);
+            size_t   nb = simd(w, base, b);
+            CHECK(na == nb);
+            for (size_t i = 0; i < na && i < nb; ++i)
+            {
+                CHECK(a[i] == b[i]);
+            }
+        }
+    }
+    CHECK(ExpandBits == GetExpandBits(ExpandBitsBestIsa));
+}
+
+int main()
+{
+    std::vector<uint64_t> words = MakeWords();
+    TestScalar(words);
+    TestSimd(words);
+
+    std::printf("%s\n", CheckFailures() ? "FAIL" : "OK");
+    return CheckFailures();
+}
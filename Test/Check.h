@@ -0,0 +1,23 @@
+#pragma once
+
+// Minimal checks for the headless tests: a failed CHECK prints where
+// and counts, main returns CheckFailures() so ctest sees the result.
+
+#include <cstdio>
+
+inline int & CheckFailures()
+{
+    static int nFailure = 0;
+    return nFailure;
+}
+
+#define CHECK(cond)                                                         \
+    do                                                                      \
+    {                                                                       \
+        if (!(cond))                                                        \
+        {                                                                   \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n",               \
+                         __FILE__, __LINE__, #cond);                        \
+            ++CheckFailures();                                              \
+        }                                                                   \
+    } while (0)
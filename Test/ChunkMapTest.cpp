@@ -0,0 +1,103 @@
+#include "pch.h"
+
+#include "Block.h"
+#include "Check.h"
+#include "ChunkMap.h"
+#include "CubeRenderer.h"
+
+#include <map>
+#include <random>
+#include <tuple>
+
+using namespace scene;
+
+typedef std::tuple<int, int, int> Key;
+
+// Random inserts, erases and finds against std::map.
+static void TestRandomOps()
+{
+    ChunkMapT<int>      m;
+    std::map<Key, int>  ref;
+    std::mt19937        rng(3);
+
+    for (int i = 0; i < 1000000; ++i)
+    {
+        int bx = static_cast<int>(rng() % 40) - 20;
+        int by = static_cast<int>(rng() % 40) - 20;
+        int bz = static_cast<int>(rng() % 20) - 10;
+        Key k(bx, by, bz);
+
+        switch (rng() % 3)
+        {
+        case 0:
+        {
+            bool isInserted;
+            m.FindOrInsert(bx, by, bz, &isInserted) = i;
+            CHECK(isInserted == (ref.count(k) == 0));
+            ref[k] = i;
+            break;
+        }
+        case 1:
+            CHECK(m.Erase(bx, by, bz) == (ref.erase(k) != 0));
+            break;
+        default:
+        {
+            const int * p = m.Find(bx, by, bz);
+            auto it = ref.find(k);
+            CHECK((p != nullptr) == (it != ref.end()));
+            CHECK(!p || *p == it->second);
+            break;
+        }
+        }
+    }
+
+    CHECK(m.Size() == ref.size());
+    size_t n = 0;
+    for (const auto & e : m)
+    {
+        CHECK(ref.at(Key(e.bx, e.by, e.bz)) == e.value);
+        ++n;
+    }
+    CHECK(n == ref.size());
+}
+
+// Coordinates equal in their low 21 bits are still different chunks.
+static void TestFarApartKeys()
+{
+    ChunkMapT<int> m;
+    const int FAR = 1 << 21;
+
+    m.FindOrInsert(0, 0, 0) = 1;
+    CHECK(!m.Find(FAR, 0, 0));
+    CHECK(!m.Find(0, -FAR, 0));
+    CHECK(!m.Find(0, 0, 2 * FAR));
+
+    m.FindOrInsert(FAR, 0, 0) = 2;
+    m.FindOrInsert(-FAR, FAR, -FAR) = 3;
+    CHECK(*m.Find(0, 0, 0) == 1);
+    CHECK(*m.Find(FAR, 0, 0) == 2);
+    CHECK(*m.Find(-FAR, FAR, -FAR) == 3);
+
+    CHECK(m.Erase(0, 0, 0));
+    CHECK(*m.Find(FAR, 0, 0) == 2);
+
+    // through BlockSystem: blocks 2^27 apart live in different chunks
+    render::PooledCubeRenderer  r(1);
+    BlockSystem                 bs;
+    bs.BindRenderer(&r);
+
+    bs.Set(0, 0, 0, GRASS_BLOCK);
+    CHECK(bs.Query(1 << 27, 0, 0) == EMPTY_BLOCK);
+    bs.Set(1 << 27, 0, 0, STONE_BLOCK);
+    CHECK(bs.Query(0, 0, 0) == GRASS_BLOCK);
+    CHECK(bs.Query(1 << 27, 0, 0) == STONE_BLOCK);
+}
+
+int main()
+{
+    TestRandomOps();
+    TestFarApartKeys();
+
+    std::printf("%s\n", CheckFailures() ? "FAIL" : "OK");
+    return CheckFailures();
+}
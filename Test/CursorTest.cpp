@@ -0,0 +1,114 @@
+#include "pch.h"
+
+#include "Block.h"
+#include "Check.h"
+#include "ChunkGeometry.h"
+#include "CubeRenderer.h"
+
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace scene;
+
+// A missing chunk found by Query is seen once it is created.
+static void TestMissThenCreate()
+{
+    render::PooledCubeRenderer  r(1);
+    BlockSystem                 bs;
+    bs.BindRenderer(&r);
+
+    bs.Set(0, 0, 0, GRASS_BLOCK);
+    CHECK(bs.Query(1000, 0, 0) == EMPTY_BLOCK);
+    bs.Set(1000, 0, 0, STONE_BLOCK);
+    CHECK(bs.Query(1000, 0, 0) == STONE_BLOCK);
+
+    // walks over chunk borders, links made in any order
+    for (int x = -200; x <= 200; x += 7)
+    {
+        bs.Set(x, 3, -5, STONE_BLOCK);
+    }
+    for (int x = -200; x <= 200; ++x)
+    {
+        CHECK(bs.Query(x, 0, 0) == (x == 0 ? GRASS_BLOCK : EMPTY_BLOCK));
+        CHECK(bs.Query(x, 3, -5) == ((x + 200) % 7 == 0 ? STONE_BLOCK : EMPTY_BLOCK));
+    }
+}
+
+// One thread querying two systems gets each one's blocks.
+static void TestTwoSystems()
+{
+    render::PooledCubeRenderer  r(1);
+    BlockSystem                 a, b;
+    a.BindRenderer(&r);
+    b.BindRenderer(&r);
+
+    a.Fill(0, 0, 0, 99, 9, 9, GRASS_BLOCK);
+    b.Fill(0, 0, 0, 99, 9, 9, STONE_BLOCK);
+    for (int x = -10; x < 110; ++x)
+    {
+        BlockType t = x >= 0 && x < 100 ? GRASS_BLOCK : EMPTY_BLOCK;
+        CHECK(a.Query(x, 5, 5) == t);
+        CHECK(b.Query(x, 5, 5) == (t == EMPTY_BLOCK ? EMPTY_BLOCK : STONE_BLOCK));
+    }
+
+    // a system made where a destroyed one was
+    std::unique_ptr<BlockSystem> c(new BlockSystem);
+    c->Set(3, 3, 3, DIRT_BLOCK);
+    CHECK(c->Query(3, 3, 3) == DIRT_BLOCK);
+    c.reset(new BlockSystem);
+    CHECK(c->Query(3, 3, 3) == EMPTY_BLOCK);
+}
+
+// Threads querying at once each walk their own cursor.
+static void TestThreads()
+{
+    render::PooledCubeRenderer  r(1);
+    BlockSystem                 bs;
+    bs.BindRenderer(&r);
+
+    // a checkerboard of chunk-sized columns
+    const int L = ChunkGeometry::LENGTH;
+    for (int cy = -4; cy < 4; ++cy)
+    for (int cx = -4; cx < 4; ++cx)
+    {
+        if ((cx + cy) & 1)
+            bs.Fill(cx * L, cy * L, 0, cx * L + L - 1, cy * L + L - 1, 3, GRASS_BLOCK);
+    }
+
+    std::vector<int>            nBad(4, 0);
+    std::vector<std::thread>    threads;
+    for (int k = 0; k < 4; ++k)
+    {
+        threads.emplace_back([&bs, &nBad, k]
+        {
+            for (int z = 0; z < 6; ++z)
+            for (int y = -4 * L; y < 4 * L; ++y)
+            for (int x = -4 * L + k; x < 4 * L; x += 4)
+            {
+                int         cx = x >= 0 ? x / L : (x - L + 1) / L;
+                int         cy = y >= 0 ? y / L : (y - L + 1) / L;
+                BlockType   t  = ((cx + cy) & 1) && z <= 3 ? GRASS_BLOCK : EMPTY_BLOCK;
+                nBad[k] += bs.Query(x, y, z) != t;
+            }
+        });
+    }
+    for (std::thread & t : threads)
+    {
+        t.join();
+    }
+    for (int n : nBad)
+    {
+        CHECK(n == 0);
+    }
+}
+
+int main()
+{
+    TestMissThenCreate();
+    TestTwoSystems();
+    TestThreads();
+
+    std::printf("%s\n", CheckFailures() ? "FAIL" : "OK");
+    return CheckFailures();
+}
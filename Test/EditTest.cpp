@@ -0,0 +1,158 @@
+#include "pch.h"
+
+#include "Block.h"
+#include "Check.h"
+#include "CubeRenderer.h"
+
+#include <random>
+#include <vector>
+
+using namespace scene;
+
+static const int R = 70;    // world box [-R, R), chunks -2 to 1
+static const int N = 2 * R;
+
+// Blocks of the world box, as the edits left them.
+struct Reference
+{
+    std::vector<BlockType> types;
+
+    Reference() : types(N * N * N, EMPTY_BLOCK) {}
+
+    BlockType & At(int x, int y, int z) { return types[((z + R) * N + (y + R)) * N + (x + R)]; }
+
+    void Fill(int x0, int y0, int z0, int x1, int y1, int z1, BlockType t)
+    {
+        for (int z = z0; z <= z1; ++z)
+        for (int y = y0; y <= y1; ++y)
+        for (int x = x0; x <= x1; ++x)
+        {
+            At(x, y, z) = t;
+        }
+    }
+};
+
+static int RandomCoord(std::mt19937 & rng)
+{
+    return static_cast<int>(rng() % N) - R;
+}
+
+// Boxes, single blocks and batches, through every edit path.
+static void Edit(BlockSystem & bs, Reference & ref, std::mt19937 & rng)
+{
+    for (int i = 0; i < 6; ++i)
+    {
+        int         x0 = RandomCoord(rng), y0 = RandomCoord(rng), z0 = RandomCoord(rng);
+        int         x1 = std::min(R - 1, x0 + static_cast<int>(rng() % 80));
+        int         y1 = std::min(R - 1, y0 + static_cast<int>(rng() % 80));
+        int         z1 = std::min(R - 1, z0 + static_cast<int>(rng() % 80));
+        BlockType   t  = rng() % 3 ? static_cast<BlockType>(1 + rng() % 4) : EMPTY_BLOCK;
+        if (t == EMPTY_BLOCK)
+            bs.Clear(x0, y0, z0, x1, y1, z1);
+        else
+            bs.Fill(x0, y0, z0, x1, y1, z1, t);
+        ref.Fill(x0, y0, z0, x1, y1, z1, t);
+    }
+
+    for (int i = 0; i < 3000; ++i)
+    {
+        int         x = RandomCoord(rng), y = RandomCoord(rng), z = RandomCoord(rng);
+        BlockType   t = static_cast<BlockType>(rng() % 5);
+        bs.Set(x, y, z, t);
+        ref.At(x, y, z) = t;
+    }
+
+    // repeats in one batch: the last one wins
+    std::vector<BlockEdit> edits;
+    for (int i = 0; i < 5000; ++i)
+    {
+        BlockEdit e = { RandomCoord(rng), RandomCoord(rng), RandomCoord(rng), static_cast<BlockType>(rng() % 5) };
+        if (i % 10 == 0 && !edits.empty())
+        {
+            e.x = edits.back().x;
+            e.y = edits.back().y;
+            e.z = edits.back().z;
+        }
+        edits.push_back(e);
+        ref.At(e.x, e.y, e.z) = e.type;
+    }
+    bs.ApplyEdits(edits.data(), edits.size());
+}
+
+// Query and Visit read back what the edits wrote.
+static void Check(const BlockSystem & bs, Reference & ref, std::mt19937 & rng)
+{
+    int nBad = 0;
+    for (int z = -R; z < R; ++z)
+    for (int y = -R; y < R; ++y)
+    for (int x = -R; x < R; ++x)
+    {
+        nBad += bs.Query(x, y, z) != ref.At(x, y, z);
+    }
+    CHECK(nBad == 0);
+
+    // each block of the box once, chunk borders inside it
+    for (int i = 0; i < 20; ++i)
+    {
+        int x0 = RandomCoord(rng), y0 = RandomCoord(rng), z0 = RandomCoord(rng);
+        int x1 = std::min(R - 1, x0 + static_cast<int>(rng() % 90));
+        int y1 = std::min(R - 1, y0 + static_cast<int>(rng() % 90));
+        int z1 = std::min(R - 1, z0 + static_cast<int>(rng() % 90));
+
+        std::vector<int> seen(N * N * N, 0);
+        nBad = 0;
+        bs.Visit(x0, y0, z0, x1, y1, z1,
+                 [&] (const BlockRun & run)
+                 {
+                     for (int k = 0; k < run.count; ++k)
+                     {
+                         int x = run.x + k;
+                         nBad += x < x0 || x > x1 || run.y < y0 || run.y > y1 || run.z < z0 || run.z > z1 ||
+                                 run[k] != ref.At(x, run.y, run.z);
+                         ++seen[((run.z + R) * N + (run.y + R)) * N + (x + R)];
+                     }
+                 });
+        for (int z = z0; z <= z1; ++z)
+        for (int y = y0; y <= y1; ++y)
+        for (int x = x0; x <= x1; ++x)
+        {
+            nBad += seen[((z + R) * N + (y + R)) * N + (x + R)] != 1;
+        }
+        CHECK(nBad == 0);
+    }
+}
+
+// Edits read back the same whether chunks are flat or turned into
+// octrees by meshing.
+static void TestReadBack()
+{
+    render::PooledCubeRenderer  r(1);
+    BlockSystem                 bs;
+    bs.BindRenderer(&r);
+
+    Reference       ref;
+    std::mt19937    rng(11);
+    for (int round = 0; round < 6; ++round)
+    {
+        Edit(bs, ref, rng);
+        Check(bs, ref, rng);
+
+        bs.SyncAll(0, 0, 0);
+        Check(bs, ref, rng);
+
+        // mostly empty chunks turn into octrees on the next mesh
+        if (round == 3)
+        {
+            bs.Clear(-R, -R, -R, R - 1, R - 1, R - 1);
+            ref.Fill(-R, -R, -R, R - 1, R - 1, R - 1, EMPTY_BLOCK);
+        }
+    }
+}
+
+int main()
+{
+    TestReadBack();
+
+    std::printf("%s\n", CheckFailures() ? "FAIL" : "OK");
+    return CheckFailures();
+}
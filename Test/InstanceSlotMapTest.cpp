@@ -0,0 +1,140 @@
+#include "pch.h"
+
+#include "Check.h"
+#include "InstanceSlotMap.h"
+
+#include <map>
+#include <random>
+#include <vector>
+
+using namespace render;
+
+typedef InstanceSlotMapT<uint32_t> SlotMap;
+
+// Apply the dirty ranges to 'gpu' the way an upload does.
+static void Upload(SlotMap & m, std::vector<uint32_t> * gpu)
+{
+    std::vector<SlotMap::Range> ranges;
+    m.TakeDirtyRanges(&ranges);
+
+    gpu->resize(m.Size());
+    uint32_t end = 0;
+    for (const SlotMap::Range & r : ranges)
+    {
+        // sorted, disjoint, within the array
+        CHECK(r.begin >= end && r.begin < r.end && r.end <= m.Size());
+        end = r.end;
+        std::copy(m.Data() + r.begin, m.Data() + r.end, gpu->begin() + r.begin);
+    }
+}
+
+static void TestSetFindErase()
+{
+    SlotMap m;
+    CHECK(m.Set(10, 100));
+    CHECK(m.Set(20, 200));
+    CHECK(!m.Set(10, 101));
+    CHECK(m.Size() == 2);
+    CHECK(*m.Find(10) == 101);
+    CHECK(*m.Find(20) == 200);
+    CHECK(!m.Find(30));
+
+    // erasing the first slot moves the last instance into it
+    CHECK(m.Erase(10));
+    CHECK(!m.Erase(10));
+    CHECK(m.Size() == 1);
+    CHECK(m.Data()[0] == 200);
+    CHECK(!m.Find(10));
+    CHECK(*m.Find(20) == 200);
+
+    m.Clear();
+    CHECK(m.Size() == 0 && !m.Find(20) && !m.IsDirty());
+}
+
+static void TestDirtyRanges()
+{
+    SlotMap                     m;
+    std::vector<SlotMap::Range> ranges;
+
+    for (uint32_t k = 0; k < 1000; ++k)
+        m.Set(k, k);
+    m.TakeDirtyRanges(&ranges);
+    CHECK(ranges.size() == 1 && ranges[0].begin == 0 && ranges[0].end == 1000);
+    CHECK(!m.IsDirty());
+
+    // one rewrite is one slot
+    m.Set(500, 7);
+    m.TakeDirtyRanges(&ranges);
+    CHECK(ranges.size() == 1 && ranges[0].begin == 500 && ranges[0].end == 501);
+
+    // slots less than nGap apart merge, farther ones don't
+    m.Set(100, 1);
+    m.Set(110, 1);
+    m.Set(300, 1);
+    m.TakeDirtyRanges(&ranges, 16);
+    CHECK(ranges.size() == 2);
+    CHECK(ranges[0].begin == 100 && ranges[0].end == 111);
+    CHECK(ranges[1].begin == 300 && ranges[1].end == 301);
+
+    // an erase dirties the hole it fills, the popped slot is gone
+    m.Erase(0);
+    m.TakeDirtyRanges(&ranges);
+    CHECK(ranges.size() == 1 && ranges[0].begin == 0 && ranges[0].end == 1);
+    CHECK(m.Data()[0] == 999);
+
+    // erasing the last slot leaves nothing to upload
+    m.Erase(998);
+    m.TakeDirtyRanges(&ranges);
+    CHECK(ranges.empty());
+
+    m.MarkAllDirty();
+    m.TakeDirtyRanges(&ranges);
+    CHECK(ranges.size() == 1 && ranges[0].begin == 0 && ranges[0].end == m.Size());
+}
+
+// Random edits against std::map, the uploaded copy must match the map.
+static void TestRandomEdits()
+{
+    SlotMap                         m;
+    std::map<uint32_t, uint32_t>    ref;
+    std::vector<uint32_t>           gpu;
+    std::mt19937                    rng(1);
+
+    for (int round = 0; round < 200; ++round)
+    {
+        int nEdit = round % 10 == 0 ? 2000 : 1 + static_cast<int>(rng() % 50);
+        for (int i = 0; i < nEdit; ++i)
+        {
+            uint32_t key = rng() % 4096;
+            if (rng() % 3 == 0)
+            {
+                CHECK(m.Erase(key) == (ref.erase(key) != 0));
+            }
+            else
+            {
+                uint32_t value = rng();
+                CHECK(m.Set(key, value) == (ref.find(key) == ref.end()));
+                ref[key] = value;
+            }
+        }
+        Upload(m, &gpu);
+
+        CHECK(m.Size() == ref.size());
+        CHECK(std::equal(gpu.begin(), gpu.end(), m.Data()));
+        for (const auto & e : ref)
+        {
+            const uint32_t * p = m.Find(e.first);
+            CHECK(p && *p == e.second);
+        }
+    }
+}
+
+int main()
+{
+    TestSetFindErase();
+    TestDirtyRanges();
+    TestRandomEdits();
+
+    std::printf("%s\n", CheckFailures() ? "FAIL" : "OK");
+    return CheckFailures();
+}
@@ -0,0 +1,315 @@
+#include "pch.h"
+
+#include "Block.h"
+#include "Check.h"
+#include "CubeRenderer.h"
+
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <set>
+#include <thread>
+#include <tuple>
+
+using namespace scene;
+
+static const std::thread::id    gMainThread = std::this_thread::get_id();
+static std::atomic<int>         gWorkerNewFailures(0);
+
+// Fail the next gWorkerNewFailures allocations off the main thread. Mesh
+// workers allocate only in BlockCube::Mesh.
+void * operator new(size_t nSize)
+{
+    if (std::this_thread::get_id() != gMainThread)
+    {
+        int n = gWorkerNewFailures.load();
+        while (n > 0 && !gWorkerNewFailures.compare_exchange_weak(n, n - 1))
+            ;
+        if (n > 0)
+            throw std::bad_alloc();
+    }
+    if (void * p = std::malloc(nSize ? nSize : 1))
+        return p;
+    throw std::bad_alloc();
+}
+void operator delete(void * p) noexcept
+{
+    std::free(p);
+}
+void operator delete(void * p, size_t) noexcept
+{
+    std::free(p);
+}
+
+typedef std::tuple<int, int, int> Block;
+typedef std::tuple<int, int, int, int, int> Face;   // block x, y, z, face, type
+
+// -x, +x, -y, +y, -z, +z and the quad axes of each, see PooledCubeRenderer::FaceVertex
+static const int FACE_NORMAL[6][3] =
+{
+    { -1, 0, 0 }, { 1, 0, 0 },
+    { 0, -1, 0 }, { 0, 1, 0 },
+    { 0, 0, -1 }, { 0, 0, 1 },
+};
+static const int U_AXIS[6] = { 2, 1, 0, 2, 1, 0 };
+static const int V_AXIS[6] = { 1, 2, 2, 0, 0, 1 };
+
+static const int R = 80;    // world box [-R, R)
+
+// Random boxes and single edits over a few chunks, both edit paths.
+static void Edit(BlockSystem & bs, std::mt19937 & rng)
+{
+    for (int i = 0; i < 5; ++i)
+    {
+        int x0 = static_cast<int>(rng() % (2 * R)) - R;
+        int y0 = static_cast<int>(rng() % (2 * R)) - R;
+        int z0 = static_cast<int>(rng() % (2 * R)) - R;
+        int x1 = std::min(R - 1, x0 + static_cast<int>(rng() % 70));
+        int y1 = std::min(R - 1, y0 + static_cast<int>(rng() % 70));
+        int z1 = std::min(R - 1, z0 + static_cast<int>(rng() % 70));
+        if (rng() % 3)
+            bs.Fill(x0, y0, z0, x1, y1, z1, static_cast<BlockType>(1 + rng() % 3));
+        else
+            bs.Clear(x0, y0, z0, x1, y1, z1);
+    }
+
+    std::vector<BlockEdit> edits;
+    for (int i = 0; i < 2000; ++i)
+    {
+        BlockEdit e = { static_cast<int>(rng() % (2 * R)) - R,
+                        static_cast<int>(rng() % (2 * R)) - R,
+                        static_cast<int>(rng() % (2 * R)) - R,
+                        static_cast<BlockType>(rng() % 4) };
+        if (i % 2)
+            edits.push_back(e);
+        else
+            bs.Set(e.x, e.y, e.z, e.type);
+    }
+    bs.ApplyEdits(edits.data(), edits.size());
+}
+
+// Solid blocks with at least one empty face neighbour.
+static std::set<Block> ExposedBlocks(const BlockSystem & bs)
+{
+    std::set<Block> exposed;
+    for (int z = -R; z < R; ++z)
+        for (int y = -R; y < R; ++y)
+            for (int x = -R; x < R; ++x)
+            {
+                if (bs.Query(x, y, z) == EMPTY_BLOCK)
+                    continue;
+                if (bs.Query(x - 1, y, z) && bs.Query(x + 1, y, z) &&
+                    bs.Query(x, y - 1, z) && bs.Query(x, y + 1, z) &&
+                    bs.Query(x, y, z - 1) && bs.Query(x, y, z + 1))
+                    continue;
+                exposed.insert(Block(x, y, z));
+            }
+    return exposed;
+}
+
+// Each exposed block is drawn once, with its type.
+static void CheckInstances(const render::PooledCubeRenderer & r, const BlockSystem & bs)
+{
+    std::set<Block> drawn;
+    size_t          nInstance = 0;
+    for (const auto & slot : r.m_instances)
+    {
+        for (const DirectX::XMFLOAT4 & v : slot)
+        {
+            int x = static_cast<int>(v.x) / 2, y = static_cast<int>(v.y) / 2, z = static_cast<int>(v.z) / 2;
+            CHECK(static_cast<int>(v.w) == bs.Query(x, y, z));
+            drawn.insert(Block(x, y, z));
+            ++nInstance;
+        }
+    }
+    CHECK(nInstance == drawn.size());
+    CHECK(drawn == ExposedBlocks(bs));
+}
+
+// Instance mode draws each exposed block once, with its type.
+static void TestInstanceExposure()
+{
+    render::PooledCubeRenderer  r(1);
+    BlockSystem                 bs;
+    bs.BindRenderer(&r);
+
+    std::mt19937 rng(3);
+    for (int round = 0; round < 6; ++round)
+    {
+        Edit(bs, rng);
+
+        // meshing overlaps the next edits
+        bs.Sync(0, 0, 0, 2);
+        Edit(bs, rng);
+        bs.SyncAll(static_cast<int>(rng() % 300), 0, 0);
+
+        CheckInstances(r, bs);
+    }
+}
+
+// Blocks cleared while their chunk is out on a worker get no instance
+// when the mesh comes back.
+static void TestClearDuringMesh()
+{
+    render::PooledCubeRenderer  r(1);
+    BlockSystem                 bs;
+    bs.BindRenderer(&r);
+
+    for (int round = 0; round < 4; ++round)
+    {
+        bs.Fill(-40, -40, -40, 40, 40, 40, static_cast<BlockType>(1 + round % 3));
+        bs.Sync(0, 0, 0, 0);
+        bs.Clear(-40, -40, -40, 40, 40, 40 - 10 * round);
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        bs.Sync(0, 0, 0, INT_MAX);
+
+        for (const auto & slot : r.m_instances)
+        {
+            for (const DirectX::XMFLOAT4 & v : slot)
+            {
+                CHECK(v.w != EMPTY_BLOCK);
+            }
+        }
+        bs.SyncAll(0, 0, 0);
+        CheckInstances(r, bs);
+    }
+}
+
+// Meshes that throw on a worker leave Sync working, their chunks are
+// meshed again on a later call.
+static void TestMeshError()
+{
+    render::PooledCubeRenderer  r(1);
+    BlockSystem                 bs;
+    bs.BindRenderer(&r);
+
+    std::mt19937 rng(7);
+    for (int round = 0; round < 3; ++round)
+    {
+        Edit(bs, rng);
+
+        gWorkerNewFailures = 4;
+        bs.SyncAll(0, 0, 0);
+        CHECK(gWorkerNewFailures == 0);
+        gWorkerNewFailures = 0;
+
+        CheckInstances(r, bs);
+    }
+}
+
+// Visible faces of solid blocks, with the block type.
+static std::multiset<Face> VisibleFaces(const BlockSystem & bs)
+{
+    std::multiset<Face> faces;
+    for (int z = -R; z < R; ++z)
+        for (int y = -R; y < R; ++y)
+            for (int x = -R; x < R; ++x)
+            {
+                BlockType t = bs.Query(x, y, z);
+                if (t == EMPTY_BLOCK)
+                    continue;
+                for (int f = 0; f < 6; ++f)
+                {
+                    if (bs.Query(x + FACE_NORMAL[f][0], y + FACE_NORMAL[f][1], z + FACE_NORMAL[f][2]) == EMPTY_BLOCK)
+                        faces.insert(Face(x, y, z, f, t));
+                }
+            }
+    return faces;
+}
+
+// Expand drawn quads into unit faces, checking their shape and winding.
+static std::multiset<Face> DrawnFaces(const render::PooledCubeRenderer & r, size_t * pTriangle)
+{
+    std::multiset<Face> faces;
+    *pTriangle = 0;
+    for (size_t s = 0; s < r.m_faces.size(); ++s)
+    {
+        const std::vector<render::PooledCubeRenderer::FaceVertex> & v = r.m_faces[s];
+        for (size_t q = 0; q + 4 <= v.size(); q += 4)
+        {
+            int f = (v[q] >> 21) & 7;
+            int c[4][3];
+            for (int k = 0; k < 4; ++k)
+            {
+                CHECK(v[q + k] >> 21 == v[q] >> 21);
+                c[k][0] = v[q + k] & 0x7f;
+                c[k][1] = (v[q + k] >> 7) & 0x7f;
+                c[k][2] = (v[q + k] >> 14) & 0x7f;
+            }
+            CHECK(f < 6);
+            if (f >= 6)
+                continue;
+
+            // (c1 - c0) x (c3 - c0) points out of the block
+            int a[3], b[3];
+            for (int i = 0; i < 3; ++i)
+            {
+                a[i] = c[1][i] - c[0][i];
+                b[i] = c[3][i] - c[0][i];
+            }
+            int n[3] = { a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0] };
+            CHECK(n[0] * FACE_NORMAL[f][0] + n[1] * FACE_NORMAL[f][1] + n[2] * FACE_NORMAL[f][2] > 0);
+
+            int w = c[1][U_AXIS[f]] - c[0][U_AXIS[f]];
+            int h = c[3][V_AXIS[f]] - c[0][V_AXIS[f]];
+            CHECK(w > 0 && h > 0);
+            for (int i = 0; i < w; ++i)
+            for (int j = 0; j < h; ++j)
+            {
+                int p[3] = { c[0][0], c[0][1], c[0][2] };
+                p[U_AXIS[f]] += i;
+                p[V_AXIS[f]] += j;
+                if (f & 1)
+                    --p[f >> 1];    // positive face: far side of the block
+                faces.insert(Face(r.m_origins[s].x + p[0], r.m_origins[s].y + p[1], r.m_origins[s].z + p[2],
+                                  f, static_cast<int>(v[q] >> 24)));
+            }
+            *pTriangle += 2;
+        }
+    }
+    return faces;
+}
+
+// Face and greedy modes draw each visible face once, with its type,
+// also when the mode changes with tasks in flight.
+static void TestFaces(BlockMeshMode mode)
+{
+    render::PooledCubeRenderer  r(1);
+    BlockSystem                 bs;
+    bs.BindRenderer(&r);
+
+    std::mt19937 rng(5);
+    for (int round = 0; round < 4; ++round)
+    {
+        Edit(bs, rng);
+
+        bs.Sync(0, 0, 0, 1);
+        bs.SetMeshMode(static_cast<BlockMeshMode>(round % 3));
+        bs.Sync(0, 0, 0, 1);
+        bs.SetMeshMode(mode);
+        bs.SyncAll(0, 0, 0);
+
+        size_t nTriangle;
+        CHECK(DrawnFaces(r, &nTriangle) == VisibleFaces(bs));
+        CHECK(nTriangle == bs.GetMeshStats().nTriangle);
+        for (const auto & slot : r.m_instances)
+        {
+            CHECK(slot.empty());
+        }
+    }
+}
+
+int main()
+{
+    TestInstanceExposure();
+    TestClearDuringMesh();
+    TestMeshError();
+    TestFaces(FACE_MESH);
+    TestFaces(GREEDY_MESH);
+
+    std::printf("%s\n", CheckFailures() ? "FAIL" : "OK");
+    return CheckFailures();
+}
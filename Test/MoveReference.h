@@ -0,0 +1,93 @@
+#pragma once
+
+// BlockSystem::Move with one Query per block cell, for the tests and
+// the benchmark to compare against.
+
+#include "Block.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace scene
+{
+    // Any solid block in the inclusive cell box.
+    inline bool AnySolidByQuery(const BlockSystem & bs, const int * lo, const int * hi)
+    {
+        for (int z = lo[2]; z <= hi[2]; ++z)
+        for (int y = lo[1]; y <= hi[1]; ++y)
+        for (int x = lo[0]; x <= hi[0]; ++x)
+        {
+            if (bs.Query(x, y, z) != EMPTY_BLOCK)
+                return true;
+        }
+        return false;
+    }
+
+    // Motion along axis a of the box at corner-space center c, half size h,
+    // up to m, stopped by the first block layer its moving face enters.
+    inline float SweepByQuery(const BlockSystem & bs, const float * c, const float * h, int a, float m)
+    {
+        const float SKIN = 1e-4f;
+
+        int lo[3], hi[3];
+        for (int i = 0; i < 3; ++i)
+        {
+            lo[i] = static_cast<int>(std::floor(c[i] - h[i] + SKIN));
+            hi[i] = static_cast<int>(std::ceil(c[i] + h[i] - SKIN)) - 1;
+        }
+
+        if (m > 0)
+        {
+            float f = c[a] + h[a];
+            for (int k = static_cast<int>(std::ceil(f - SKIN)); k <= static_cast<int>(std::ceil(f + m)) - 1; ++k)
+            {
+                lo[a] = hi[a] = k;
+                if (AnySolidByQuery(bs, lo, hi))
+                    return std::max(k - f, 0.0f);
+            }
+        }
+        else
+        {
+            float f = c[a] - h[a];
+            for (int k = static_cast<int>(std::floor(f + SKIN)) - 1; k >= static_cast<int>(std::floor(f + m)); --k)
+            {
+                lo[a] = hi[a] = k;
+                if (AnySolidByQuery(bs, lo, hi))
+                    return std::min(k + 1 - f, 0.0f);
+            }
+        }
+        return m;
+    }
+
+    // Same rules as BlockSystem::Move: z, then x, then y.
+    inline void MoveByQuery(const BlockSystem & bs, BlockBody * pBodies, size_t nCount)
+    {
+        static const int AXES[3] = { 2, 0, 1 };
+
+        for (size_t i = 0; i < nCount; ++i)
+        {
+            BlockBody & b = pBodies[i];
+
+            // blocks span [k - 0.5, k + 0.5], shift so they span [k, k + 1]
+            float c[3] = { b.x + 0.5f, b.y + 0.5f, b.z + 0.5f };
+            float h[3] = { b.hx, b.hy, b.hz };
+            float m[3] = { b.dx, b.dy, b.dz };
+
+            b.contacts = 0;
+            for (int a : AXES)
+            {
+                if (m[a] == 0)
+                    continue;
+
+                float d = SweepByQuery(bs, c, h, a, m[a]);
+                if (d != m[a])
+                    b.contacts |= 1 << (2 * a + (m[a] > 0));
+                c[a] += d;
+                m[a] = d;
+            }
+
+            b.x = c[0] - 0.5f; b.y = c[1] - 0.5f; b.z = c[2] - 0.5f;
+            b.dx = m[0]; b.dy = m[1]; b.dz = m[2];
+        }
+    }
+}
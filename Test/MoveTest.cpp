@@ -0,0 +1,160 @@
+#include "pch.h"
+
+#include "Block.h"
+#include "Check.h"
+#include "ChunkGeometry.h"
+#include "CubeRenderer.h"
+#include "MoveReference.h"
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace scene;
+
+// Any solid block the body overlaps by more than eps.
+static bool IsInside(const BlockSystem & bs, const BlockBody & b, float eps = 1e-3f)
+{
+    float   c[3] = { b.x + 0.5f, b.y + 0.5f, b.z + 0.5f };
+    float   h[3] = { b.hx, b.hy, b.hz };
+    int     lo[3], hi[3];
+    for (int i = 0; i < 3; ++i)
+    {
+        lo[i] = static_cast<int>(std::floor(c[i] - h[i] + eps));
+        hi[i] = static_cast<int>(std::ceil(c[i] + h[i] - eps)) - 1;
+    }
+    return AnySolidByQuery(bs, lo, hi);
+}
+
+static void TestLandAndSlide()
+{
+    render::PooledCubeRenderer  r(1);
+    BlockSystem                 bs;
+    bs.BindRenderer(&r);
+    bs.Fill(-5, -5, -5, 5, 5, 0, GRASS_BLOCK);
+
+    // falls onto the top of block 0 at z 0.5
+    BlockBody b = { 0.2f, 0.3f, 3.0f, 0.3f, 0.3f, 0.9f, 0, 0, -10, 0 };
+    bs.Move(&b, 1);
+    CHECK(std::abs(b.z - 1.4f) < 1e-5f);
+    CHECK(std::abs(b.dz + 1.6f) < 1e-5f);
+    CHECK(b.contacts == CONTACT_NEG_Z);
+
+    // stopped by a wall along x, keeps its motion along y
+    BlockBody w = { 0, 0, 1.5f, 0.3f, 0.3f, 0.9f, 20, 0.5f, 0, 0 };
+    bs.Fill(3, -5, 1, 3, 5, 5, STONE_BLOCK);
+    bs.Move(&w, 1);
+    CHECK(std::abs(w.x - 2.2f) < 1e-5f);
+    CHECK(std::abs(w.y - 0.5f) < 1e-6f);
+    CHECK(w.contacts == CONTACT_POS_X);
+}
+
+// Bodies falling from z0 and wandering within range of the origin end
+// where one Query per cell puts them, and never inside a block.
+static void RunAgainstQuery(const BlockSystem & bs, std::mt19937 & rng, float range, float z0)
+{
+    std::uniform_real_distribution<float> u(-1, 1);
+
+    const int               N = 1024;
+    std::vector<BlockBody>  bodies(N);
+    std::vector<float>      vz(N, 0);
+    for (BlockBody & b : bodies)
+    {
+        b = { u(rng) * range, u(rng) * range, z0 + 10 * u(rng), 0.3f, 0.3f, 0.9f, 0, 0, 0, 0 };
+    }
+
+    for (int tick = 0; tick < 150; ++tick)
+    {
+        for (int i = 0; i < N; ++i)
+        {
+            vz[i] -= 0.02f;
+            bodies[i].dx = u(rng) * 0.3f;
+            bodies[i].dy = u(rng) * 0.3f;
+            bodies[i].dz = vz[i];
+            if (tick % 50 == 0)
+            {
+                // long moves across many layers
+                bodies[i].dx *= 20;
+                bodies[i].dy *= 20;
+            }
+        }
+
+        std::vector<BlockBody> ref = bodies;
+        bs.Move(bodies.data(), N);
+        MoveByQuery(bs, ref.data(), N);
+
+        for (int i = 0; i < N; ++i)
+        {
+            const BlockBody & a = bodies[i];
+            const BlockBody & b = ref[i];
+            CHECK(a.x == b.x && a.y == b.y && a.z == b.z && a.contacts == b.contacts);
+            CHECK(!IsInside(bs, a));
+            if (a.contacts & (CONTACT_NEG_Z | CONTACT_POS_Z))
+                vz[i] = 0;
+        }
+    }
+}
+
+// Terrain with pillars.
+static void TestAgainstQuery(bool isMeshed)
+{
+    render::PooledCubeRenderer  r(1);
+    BlockSystem                 bs;
+    bs.BindRenderer(&r);
+    bs.SetGpuBudget(size_t(1) << 31);
+
+    std::mt19937 rng(3);
+
+    const int R = 100;
+    for (int x = -R; x < R; ++x)
+    for (int y = -R; y < R; ++y)
+    {
+        int h = static_cast<int>(6 * std::sin(x * 0.05f) + 6 * std::cos(y * 0.07f));
+        bs.Fill(x, y, -40, x, y, h, static_cast<BlockType>(1 + ((x ^ y) & 3)));
+    }
+    for (int i = 0; i < 100; ++i)
+    {
+        int x = static_cast<int>(rng() % (2 * R)) - R, y = static_cast<int>(rng() % (2 * R)) - R;
+        bs.Fill(x, y, -10, x + rng() % 3, y + rng() % 3, 20, STONE_BLOCK);
+    }
+    for (int i = 0; i < 1000; ++i)
+    {
+        bs.Set(static_cast<int>(rng() % (2 * R)) - R, static_cast<int>(rng() % (2 * R)) - R,
+               static_cast<int>(rng() % 30), DIRT_BLOCK);
+    }
+    // flat chunks answer from occupancy rows, meshing turns some into
+    // octrees that answer from storage
+    if (isMeshed)
+        bs.SyncAll(0, 0, 0);
+
+    RunAgainstQuery(bs, rng, 90, 40);
+}
+
+// Whole chunks of one type, solid and cleared, have no rows.
+static void TestUniformChunks()
+{
+    render::PooledCubeRenderer  r(1);
+    BlockSystem                 bs;
+    bs.BindRenderer(&r);
+
+    const int L = ChunkGeometry::LENGTH;
+    bs.Fill(-L, -L, -L, L - 1, L - 1, -1, STONE_BLOCK);
+    bs.Fill(0, 0, 0, L - 1, L - 1, L - 1, GRASS_BLOCK);
+    bs.Fill(-L, 0, 0, -L + 3, L - 1, L - 1, DIRT_BLOCK);
+    bs.Fill(-L, -L, 0, L - 1, -1, L - 1, DIRT_BLOCK);
+    bs.Clear(-L, -L, 0, L - 1, -1, L - 1);
+
+    std::mt19937 rng(5);
+    RunAgainstQuery(bs, rng, static_cast<float>(L), static_cast<float>(L + 20));
+}
+
+int main()
+{
+    TestLandAndSlide();
+    TestAgainstQuery(false);
+    TestAgainstQuery(true);
+    TestUniformChunks();
+
+    std::printf("%s\n", CheckFailures() ? "FAIL" : "OK");
+    return CheckFailures();
+}
@@ -0,0 +1,264 @@
+#include "pch.h"
+
+#include "Block.h"
+#include "Check.h"
+#include "CubeRenderer.h"
+
+#include <cfloat>
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace scene;
+
+// Boxes, scattered blocks and a hollow shell, meshed so chunks have their
+// occupancy pyramid. Blocks are unit cubes centered on integer coordinates.
+static void BuildScene(BlockSystem & bs, std::mt19937 & rng)
+{
+    for (int i = 0; i < 60; ++i)
+    {
+        int x = static_cast<int>(rng() % 400) - 200;
+        int y = static_cast<int>(rng() % 400) - 200;
+        int z = static_cast<int>(rng() % 400) - 200;
+        bs.Fill(x, y, z, x + rng() % 20, y + rng() % 20, z + rng() % 20, static_cast<BlockType>(1 + rng() % 4));
+    }
+    for (int i = 0; i < 3000; ++i)
+    {
+        bs.Set(static_cast<int>(rng() % 400) - 200, static_cast<int>(rng() % 400) - 200,
+               static_cast<int>(rng() % 400) - 200, static_cast<BlockType>(1 + rng() % 4));
+    }
+    for (int i = 0; i < 4000; ++i)
+    {
+        bs.Set(static_cast<int>(rng() % 120) - 60, static_cast<int>(rng() % 120) - 60,
+               static_cast<int>(rng() % 120) - 60, static_cast<BlockType>(1 + rng() % 4));
+    }
+    bs.Clear(-3, -3, -3, 3, 3, 3);
+    bs.Fill(100, 100, 100, 200, 200, 200, STONE_BLOCK);
+    bs.Clear(101, 101, 101, 199, 199, 199);
+    bs.SyncAll(0, 0, 0);
+}
+
+// First solid block along tiny fixed steps.
+static bool StepRaycast(const BlockSystem & bs, float ox, float oy, float oz,
+                        float dx, float dy, float dz, float maxDistance, int * pHit)
+{
+    float len = std::sqrt(dx * dx + dy * dy + dz * dz);
+    dx /= len; dy /= len; dz /= len;
+    for (float t = 0; t <= maxDistance; t += 0.0005f)
+    {
+        int x = static_cast<int>(std::floor(ox + dx * t + 0.5f));
+        int y = static_cast<int>(std::floor(oy + dy * t + 0.5f));
+        int z = static_cast<int>(std::floor(oz + dz * t + 0.5f));
+        if (bs.Query(x, y, z) != EMPTY_BLOCK)
+        {
+            pHit[0] = x; pHit[1] = y; pHit[2] = z;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Raycast finds the block fixed steps find, and reports a face of it.
+static void TestAgainstSteps()
+{
+    render::PooledCubeRenderer  r(1);
+    BlockSystem                 bs;
+    bs.BindRenderer(&r);
+
+    std::mt19937 rng(7);
+    BuildScene(bs, rng);
+
+    std::uniform_real_distribution<float> u(-1, 1);
+    int nHit = 0;
+    for (int i = 0; i < 200; ++i)
+    {
+        float ox = u(rng) * 20, oy = u(rng) * 20, oz = u(rng) * 20;
+        float dx = u(rng), dy = u(rng), dz = u(rng);
+        if (i % 10 == 0)
+            dy = dz = 0;    // along an axis
+        if (i % 13 == 0)
+            dx = 0;
+
+        BlockRayHit h       = {};
+        int         ref[3]  = {};
+        bool        isHit   = bs.Raycast(ox, oy, oz, dx, dy, dz, 300, &h);
+        CHECK(isHit == StepRaycast(bs, ox, oy, oz, dx, dy, dz, 300, ref));
+        if (!isHit)
+            continue;
+
+        ++nHit;
+        CHECK(h.x == ref[0] && h.y == ref[1] && h.z == ref[2]);
+        CHECK(h.type == bs.Query(h.x, h.y, h.z));
+        CHECK(std::abs(h.nx) + std::abs(h.ny) + std::abs(h.nz) == 1);
+        CHECK(h.px == h.x + h.nx && h.py == h.y + h.ny && h.pz == h.z + h.nz);
+        CHECK(bs.Query(h.px, h.py, h.pz) == EMPTY_BLOCK);
+
+        // the entry point lies on the face
+        float   len     = std::sqrt(dx * dx + dy * dy + dz * dz);
+        float   p[3]    = { ox + dx / len * h.distance, oy + dy / len * h.distance, oz + dz / len * h.distance };
+        int     c[3]    = { h.x, h.y, h.z };
+        int     n[3]    = { h.nx, h.ny, h.nz };
+        for (int k = 0; k < 3; ++k)
+        {
+            if (n[k])
+                CHECK(std::abs(p[k] - (c[k] + 0.5f * n[k])) < 1e-2f);
+        }
+    }
+    CHECK(nHit > 20);
+
+    // a ray starting inside a block hits it at once, with no face
+    BlockRayHit h = {};
+    bs.Set(0, 0, 0, GRASS_BLOCK);
+    CHECK(bs.Raycast(0.1f, 0, 0, 1, 0, 0, 5, &h));
+    CHECK(h.x == 0 && h.nx == 0 && h.ny == 0 && h.nz == 0 && h.px == 0 && h.distance == 0);
+}
+
+// Packets return exactly what single rays do, also for rays through
+// block edges and corners.
+static void TestPacketsMatchSingle()
+{
+    render::PooledCubeRenderer  r(1);
+    BlockSystem                 bs;
+    bs.BindRenderer(&r);
+
+    std::mt19937 rng(3);
+    for (int i = 0; i < 20000; ++i)
+    {
+        bs.Set(static_cast<int>(rng() % 160) - 80, static_cast<int>(rng() % 160) - 80,
+               static_cast<int>(rng() % 160) - 80, static_cast<BlockType>(1 + rng() % 4));
+    }
+    bs.Fill(-200, -200, -100, 200, 200, -90, STONE_BLOCK);
+    bs.SyncAll(0, 0, 0);
+
+    // integer and quarter-unit origins, integer directions: many ties
+    std::vector<BlockRay> rays;
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        float q = pass ? 0.25f : 1.0f;
+        for (int i = 0; i < 10000; ++i)
+        {
+            BlockRay ray =
+            {
+                (static_cast<int>(rng() % 320) - 160) * q,
+                (static_cast<int>(rng() % 320) - 160) * q,
+                (static_cast<int>(rng() % 320) - 160) * q,
+                static_cast<float>(static_cast<int>(rng() % 21) - 10),
+                static_cast<float>(static_cast<int>(rng() % 21) - 10),
+                static_cast<float>(static_cast<int>(rng() % 21) - 10),
+                300,
+            };
+            if (i % 7 == 0)
+                ray.dz = ray.dx;
+            if (i % 11 == 0)
+                ray.dy = -ray.dx;
+            rays.push_back(ray);
+        }
+    }
+    rays.push_back({ 71.5f, 34.25f, 1.75f, -9, 81, 27, 300 });
+
+    std::uniform_real_distribution<float> u(-1, 1);
+    for (int i = 0; i < 10000; ++i)
+    {
+        rays.push_back({ u(rng) * 100, u(rng) * 100, u(rng) * 100, u(rng), u(rng), u(rng), 200 + u(rng) * 100 });
+    }
+
+    std::vector<BlockRayHit> hits(rays.size());
+    bs.Raycast(rays.data(), rays.size(), hits.data());
+
+    int nHit = 0;
+    for (size_t i = 0; i < rays.size(); ++i)
+    {
+        const BlockRay &    ray = rays[i];
+        const BlockRayHit & h2  = hits[i];
+        BlockRayHit         h1  = {};
+        if (ray.dx == 0 && ray.dy == 0 && ray.dz == 0)
+            continue;
+
+        bool isHit = bs.Raycast(ray.ox, ray.oy, ray.oz, ray.dx, ray.dy, ray.dz, ray.maxDistance, &h1);
+        CHECK(isHit == (h2.type != EMPTY_BLOCK));
+        if (!isHit)
+            continue;
+
+        ++nHit;
+        CHECK(h1.x == h2.x && h1.y == h2.y && h1.z == h2.z);
+        CHECK(h1.nx == h2.nx && h1.ny == h2.ny && h1.nz == h2.nz);
+        CHECK(h1.type == h2.type && h1.distance == h2.distance);
+    }
+    CHECK(nHit > 1000);
+}
+
+// Rays without a direction or with non-finite input hit nothing, and a
+// ray of any length ends once it has left the chunks.
+static void TestDegenerateRays()
+{
+    render::PooledCubeRenderer  r(1);
+    BlockSystem                 bs;
+    bs.BindRenderer(&r);
+
+    BlockRay bad[] =
+    {
+        { -5, 5, 5, 0, 0, 0, 100 },
+        { -5, 5, 5, NAN, 1, 0, 100 },
+        { -5, 5, 5, INFINITY, 0, 0, 100 },
+        { -5, 5, 5, 1, 0, 0, INFINITY },
+        { -5, 5, 5, 1, 0, 0, NAN },
+        { -5, 5, 5, 1, 0, 0, -1 },
+        { NAN, 5, 5, 1, 0, 0, 100 },
+        { -1e20f, 5, 5, 1, 0, 0, FLT_MAX },
+    };
+    BlockRay far[] =
+    {
+        { -5, 5, 5, 1, 0, 0, FLT_MAX },
+        { -5, 5, 5, -1, 0, 0, FLT_MAX },
+        { -5, 5, 5, 0, 0, 1, FLT_MAX },
+        { -5, 5, 5, 1, 1e-6f, -1e-6f, FLT_MAX },
+        { -1e6f, 5, 5, 1, 0, 0, FLT_MAX },
+        { 1e6f, -1e6f, 1e6f, -1, 1, -1, FLT_MAX },
+    };
+
+    // nothing loaded, then a box at the origin
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        if (pass)
+            bs.Fill(0, 0, 0, 10, 10, 10, GRASS_BLOCK);
+
+        BlockRayHit h = {};
+        for (const BlockRay & ray : bad)
+        {
+            CHECK(!bs.Raycast(ray.ox, ray.oy, ray.oz, ray.dx, ray.dy, ray.dz, ray.maxDistance, &h));
+        }
+
+        bool isHit[] = { true, false, false, true, true, true };
+        for (size_t i = 0; i < sizeof(far) / sizeof(far[0]); ++i)
+        {
+            const BlockRay & ray = far[i];
+            CHECK(bs.Raycast(ray.ox, ray.oy, ray.oz, ray.dx, ray.dy, ray.dz, ray.maxDistance, &h) ==
+                  (pass && isHit[i]));
+        }
+        if (pass)
+        {
+            CHECK(bs.Raycast(-1e6f, 5, 5, 1, 0, 0, FLT_MAX, &h));
+            CHECK(h.x == 0 && h.y == 5 && h.z == 5 && h.nx == -1);
+        }
+
+        std::vector<BlockRay> rays(bad, bad + sizeof(bad) / sizeof(bad[0]));
+        rays.insert(rays.end(), far, far + sizeof(far) / sizeof(far[0]));
+        std::vector<BlockRayHit> hits(rays.size());
+        bs.Raycast(rays.data(), rays.size(), hits.data());
+        for (size_t i = 0; i < rays.size(); ++i)
+        {
+            size_t j = i - sizeof(bad) / sizeof(bad[0]);
+            CHECK((hits[i].type != EMPTY_BLOCK) == (pass && i >= sizeof(bad) / sizeof(bad[0]) && isHit[j]));
+        }
+    }
+}
+
+int main()
+{
+    TestAgainstSteps();
+    TestPacketsMatchSingle();
+    TestDegenerateRays();
+
+    std::printf("%s\n", CheckFailures() ? "FAIL" : "OK");
+    return CheckFailures();
+}
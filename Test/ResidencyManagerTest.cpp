@@ -0,0 +1,343 @@
+#include "pch.h"
+
+#include "Block.h"
+#include "Check.h"
+#include "ChunkGeometry.h"
+#include "CubeRenderer.h"
+#include "ResidencyManager.h"
+
+#include <map>
+#include <random>
+#include <set>
+#include <vector>
+
+using namespace scene;
+
+static const int L = ChunkGeometry::LENGTH;
+
+static int OwnerIndex(void * pOwner, int * owners)
+{
+    return static_cast<int>(static_cast<int *>(pOwner) - owners);
+}
+
+static void TestEvictFarthest()
+{
+    ResidencyManager    m(300, 8);
+    int                 owners[8];
+    std::vector<int>    evicted;
+
+    m.SetEvictCallback([&] (void * pOwner, int) { evicted.push_back(OwnerIndex(pOwner, owners)); });
+    m.Update(0, 0, 0);
+
+    int a = m.Acquire(&owners[0], 0, 0, 0, 100);
+    int b = m.Acquire(&owners[1], 5, 0, 0, 100);
+    int c = m.Acquire(&owners[2], 2, 0, 0, 100);
+    CHECK(a == 0 && b == 1 && c == 2);
+
+    // over budget: the farthest chunk goes, its slot is reused
+    int d = m.Acquire(&owners[3], 1, 0, 0, 100);
+    CHECK(evicted.size() == 1 && evicted.back() == 1);
+    CHECK(d == b);
+
+    // never for a chunk farther than every resident one
+    CHECK(m.Acquire(&owners[4], 9, 0, 0, 100) == ResidencyManager::NONE);
+    CHECK(m.GetStats().nRejected == 1);
+
+    // the camera moves, now chunk 0 is the farthest
+    m.Update(10, 0, 0);
+    CHECK(m.Acquire(&owners[4], 9, 0, 0, 100) != ResidencyManager::NONE);
+    CHECK(evicted.back() == 0);
+
+    // a lower budget evicts down to it
+    m.SetBudget(100);
+    ResidencyManager::Stats s = m.GetStats();
+    CHECK(s.nResident == 1 && s.nBytes == 100 && s.nEvicted == 4);
+    CHECK(evicted.back() == 2);
+}
+
+static void TestEvictLeastRecentlyUsed()
+{
+    ResidencyManager    m(200, 8);
+    int                 owners[3];
+    std::vector<int>    evicted;
+
+    m.SetEvictCallback([&] (void * pOwner, int) { evicted.push_back(OwnerIndex(pOwner, owners)); });
+
+    m.Acquire(&owners[0], 4, 0, 0, 100);
+    int b = m.Acquire(&owners[1], -4, 0, 0, 100);
+    m.Update(0, 0, 0);
+    m.Touch(b, 100);
+
+    // equally far: the one not touched since goes first
+    m.Acquire(&owners[2], 1, 0, 0, 100);
+    CHECK(evicted.size() == 1 && evicted.back() == 0);
+
+    // growing past the budget evicts the farthest, here itself
+    CHECK(!m.Touch(b, 150));
+    CHECK(evicted.back() == 1);
+}
+
+static void TestEvictLeastRecentlySeen()
+{
+    ResidencyManager    m(200, 8);
+    int                 owners[3];
+    std::vector<int>    evicted;
+
+    m.SetEvictCallback([&] (void * pOwner, int) { evicted.push_back(OwnerIndex(pOwner, owners)); });
+    m.Update(0, 0, 0);
+    m.Acquire(&owners[0], 4, 0, 0, 100);
+    m.Acquire(&owners[1], -4, 0, 0, 100);
+
+    // the camera visits chunk 0 and sees it, chunk 1 is out of range
+    m.Update(6, 0, 0);
+    m.TouchWithin(9);
+    m.Update(0, 0, 0);
+
+    // equally far again: the one not seen since goes first
+    m.Acquire(&owners[2], 1, 0, 0, 100);
+    CHECK(evicted.size() == 1 && evicted.back() == 1);
+}
+
+// Random operations evict what a scan over all residents would pick.
+static void TestVictimOrder()
+{
+    struct Resident
+    {
+        int         bx, by, bz;
+        uint64_t    lastSeen;
+    };
+
+    ResidencyManager            m(1000, 64);
+    int                         owners[200];
+    std::map<int *, Resident>   ref;
+    std::map<int *, int>        slots;
+    std::mt19937                rng(7);
+    uint64_t                    clock = 0;
+    int                         cbx = 0, cby = 0, cbz = 0;
+    bool                        isVictimValid = true;
+
+    auto distanceSq = [&] (const Resident & r)
+    {
+        int64_t dx = r.bx - cbx, dy = r.by - cby, dz = r.bz - cbz;
+        return dx * dx + dy * dy + dz * dz;
+    };
+
+    m.SetEvictCallback(
+        [&] (void * pOwner, int)
+        {
+            int * p = static_cast<int *>(pOwner);
+            for (const auto & e : ref)
+            {
+                int64_t d = distanceSq(e.second), dp = distanceSq(ref.at(p));
+                isVictimValid = isVictimValid &&
+                    (d < dp || (d == dp && e.second.lastSeen >= ref.at(p).lastSeen));
+            }
+            ref.erase(p);
+            slots.erase(p);
+        });
+    m.SetMoveCallback([&] (void * pOwner, int, int nTo) { slots[static_cast<int *>(pOwner)] = nTo; });
+
+    for (int i = 0; i < 20000; ++i)
+    {
+        int * p = &owners[rng() % 200];
+        switch (rng() % 6)
+        {
+        case 0:
+            cbx = static_cast<int>(rng() % 9) - 4;
+            cby = static_cast<int>(rng() % 9) - 4;
+            m.Update(cbx, cby, cbz);
+            ++clock;
+            break;
+        case 1:
+            m.TouchWithin(9);
+            for (auto & e : ref)
+            {
+                if (distanceSq(e.second) <= 9)
+                    e.second.lastSeen = clock;
+            }
+            break;
+        case 2:
+            if (slots.count(p))
+            {
+                m.Release(slots[p]);
+                ref.erase(p);
+                slots.erase(p);
+            }
+            break;
+        case 3:
+            if (rng() % 4 == 0)
+                m.Compact();
+            break;
+        default:
+            if (!slots.count(p))
+            {
+                Resident r = { static_cast<int>(rng() % 17) - 8, static_cast<int>(rng() % 17) - 8, 0, clock };
+                int nSlot = m.Acquire(p, r.bx, r.by, r.bz, 10 + rng() % 40);
+                if (nSlot != ResidencyManager::NONE)
+                {
+                    ref[p] = r;
+                    slots[p] = nSlot;
+                }
+            }
+            break;
+        }
+    }
+    CHECK(isVictimValid);
+    CHECK(m.GetResidentCount() == ref.size());
+    CHECK(m.GetStats().nEvicted > 100);
+}
+
+static void TestSlotLimit()
+{
+    ResidencyManager    m(1 << 30, 4);
+    int                 owners[5];
+
+    for (int i = 0; i < 4; ++i)
+        CHECK(m.Acquire(&owners[i], i, 0, 0, 1) == i);
+
+    // slots run out before bytes do
+    CHECK(m.Acquire(&owners[4], 1, 1, 0, 1) == 3);
+    CHECK(m.GetSlotCount() == 4 && m.GetResidentCount() == 4);
+}
+
+static void TestCompact()
+{
+    ResidencyManager        m(1 << 30, 64);
+    int                     owners[16];
+    std::map<int *, int>    slots;
+    bool                    isMoveValid = true;
+
+    m.SetMoveCallback(
+        [&] (void * pOwner, int nFrom, int nTo)
+        {
+            int * p = static_cast<int *>(pOwner);
+            isMoveValid = isMoveValid && slots.at(p) == nFrom && nTo < nFrom;
+            slots[p] = nTo;
+        });
+
+    for (int i = 0; i < 10; ++i)
+        slots[&owners[i]] = m.Acquire(&owners[i], i, 0, 0, 10);
+    for (int i : { 0, 2, 3, 7 })
+    {
+        m.Release(slots[&owners[i]]);
+        slots.erase(&owners[i]);
+    }
+
+    CHECK(m.Compact() == 6);
+    CHECK(m.GetSlotCount() == 6 && m.GetResidentCount() == 6);
+    CHECK(isMoveValid);
+
+    // residents hold slots 0-5, one each
+    std::set<int> used;
+    for (const auto & e : slots)
+        used.insert(e.second);
+    CHECK(used.size() == 6 && *used.begin() == 0 && *used.rbegin() == 5);
+
+    // no free slot left behind: the next one appends
+    CHECK(m.Acquire(&owners[12], 1, 0, 0, 10) == 6);
+
+    // nothing to move
+    CHECK(m.Compact() == 7);
+}
+
+// Chunks with one block each at x = i * L + 1.
+static void FillChunkRow(BlockSystem & bs, int n, BlockType t)
+{
+    for (int i = 0; i < n; ++i)
+        bs.Set(i * L + 1, 1, 1, t);
+}
+
+// Chunk x of every drawn instance, checking the rest of its position.
+static std::multiset<int> DrawnChunks(const render::PooledCubeRenderer & r)
+{
+    std::multiset<int> chunks;
+    for (const auto & slot : r.m_instances)
+    {
+        for (const DirectX::XMFLOAT4 & v : slot)
+        {
+            int x = static_cast<int>(v.x) / 2;
+            CHECK(x % L == 1 && v.y == 2.0f && v.z == 2.0f);
+            chunks.insert(x / L);
+        }
+    }
+    return chunks;
+}
+
+static void TestBlockSystemBudget()
+{
+    const size_t INSTANCE_BYTES = sizeof(render::PooledCubeRenderer::CubeInstance);
+
+    render::PooledCubeRenderer  r(1);
+    BlockSystem                 bs;
+    bs.BindRenderer(&r);
+    bs.SetGpuBudget(5 * INSTANCE_BYTES);
+
+    FillChunkRow(bs, 20, GRASS_BLOCK);
+    bs.SyncAll(0, 0, 0);
+
+    BlockResidencyStats s = bs.GetResidencyStats();
+    CHECK(s.nResident == 5 && s.nRejected == 15);
+    CHECK(DrawnChunks(r) == std::multiset<int>({ 0, 1, 2, 3, 4 }));
+
+    // the camera crosses to the far end, slotless chunks get retried
+    bs.SyncAll(19 * L, 0, 0);
+    s = bs.GetResidencyStats();
+    CHECK(s.nResident == 5 && s.nEvicted == 5);
+    CHECK(DrawnChunks(r) == std::multiset<int>({ 15, 16, 17, 18, 19 }));
+
+    // the pool follows a lower budget down
+    bs.SetGpuBudget(2 * INSTANCE_BYTES);
+    s = bs.GetResidencyStats();
+    CHECK(s.nResident == 2 && s.nSlot == 2 && r.GetPoolSize() == 2);
+    CHECK(DrawnChunks(r) == std::multiset<int>({ 18, 19 }));
+}
+
+static void TestBlockSystemShrink()
+{
+    render::PooledCubeRenderer  r(8);
+    BlockSystem                 bs;
+    bs.BindRenderer(&r);
+
+    FillChunkRow(bs, 200, GRASS_BLOCK);
+    bs.SyncAll(0, 0, 0);
+    BlockResidencyStats s = bs.GetResidencyStats();
+    CHECK(s.nResident == 200 && s.nSlot == 200 && r.GetPoolSize() == 200);
+
+    // emptied chunks release their slots, Sync shrinks the pool but
+    // keeps up to 64 spare slots
+    for (int i = 5; i < 200; ++i)
+        bs.Set(i * L + 1, 1, 1, EMPTY_BLOCK);
+    bs.SyncAll(0, 0, 0);
+    s = bs.GetResidencyStats();
+    CHECK(s.nResident == 5 && s.nSlot <= 2 * 5 + 64 && r.GetPoolSize() == s.nSlot);
+    CHECK(DrawnChunks(r) == std::multiset<int>({ 0, 1, 2, 3, 4 }));
+
+    // a budget change packs the pool down to the residents
+    bs.SetGpuBudget(1 << 20);
+    s = bs.GetResidencyStats();
+    CHECK(s.nResident == 5 && s.nSlot == 5 && r.GetPoolSize() == 5);
+    CHECK(DrawnChunks(r) == std::multiset<int>({ 0, 1, 2, 3, 4 }));
+
+    // moved slots keep patching the right buffers
+    bs.Set(3 * L + 2, 1, 1, GRASS_BLOCK);
+    bs.SyncAll(0, 0, 0);
+    size_t n = 0;
+    for (const auto & slot : r.m_instances)
+        n += slot.size();
+    CHECK(n == 6);
+}
+
+int main()
+{
+    TestEvictFarthest();
+    TestEvictLeastRecentlyUsed();
+    TestEvictLeastRecentlySeen();
+    TestVictimOrder();
+    TestSlotLimit();
+    TestCompact();
+    TestBlockSystemBudget();
+    TestBlockSystemShrink();
+
+    std::printf("%s\n", CheckFailures() ? "FAIL" : "OK");
+    return CheckFailures();
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+// Stand-in for Source/CubeRenderer.h in headless builds: the
+// PooledCubeRenderer interface the block system calls, with each slot's
+// uploads kept in vectors. Instances are stored in world space as the
+// real instance buffer draws them, blocks at 2 * (x, y, z).
+
+#include "InstanceSlotMap.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace render
+{
+    class PooledCubeRenderer
+    {
+    public:
+        enum Type
+        {
+            TEXTURE         = 0,
+
+            MAX_TYPE,
+        };
+
+        // bits 0-17 block x, y, z relative to the chunk origin, bits 24-31 block type
+        typedef uint32_t CubeInstance;
+
+        static CubeInstance PackCubeInstance(int x, int y, int z, int type)
+        {
+            return static_cast<CubeInstance>(x | (y << 6) | (z << 12) | (type << 24));
+        }
+        static void UnpackCubeInstance(CubeInstance c, int * pX, int * pY, int * pZ, int * pType)
+        {
+            *pX     = static_cast<int>(c & 0x3f);
+            *pY     = static_cast<int>((c >> 6) & 0x3f);
+            *pZ     = static_cast<int>((c >> 12) & 0x3f);
+            *pType  = static_cast<int>(c >> 24);
+        }
+
+        typedef InstanceSlotMapT<CubeInstance> InstanceSlotMap;
+
+        // bits 0-20 corner x, y, z, bits 21-23 face, bits 24-31 block type
+        typedef uint32_t FaceVertex;
+
+        static FaceVertex PackFaceVertex(int x, int y, int z, int face, int type)
+        {
+            return static_cast<FaceVertex>(x | (y << 7) | (z << 14) | (face << 21) | (type << 24));
+        }
+
+        struct Origin
+        {
+            int x, y, z;
+        };
+
+        PooledCubeRenderer(int nPoolSize)
+            : m_instances(nPoolSize)
+            , m_faces(nPoolSize)
+            , m_origins(nPoolSize)
+            , m_sources(nPoolSize, nullptr)
+            , m_nUploadBytes(0)
+        {
+        }
+
+        void            UpdateInstanceBuffer(size_t nIndex,
+                                             Type type,
+                                             InstanceSlotMap & instances,
+                                             int x, int y, int z)
+        {
+            (void)type;
+
+            // another chunk's map was here last: upload everything
+            if (m_sources.at(nIndex) != &instances)
+            {
+                instances.MarkAllDirty();
+                m_sources[nIndex] = &instances;
+            }
+
+            std::vector<DirectX::XMFLOAT4> & v = m_instances[nIndex];
+            v.resize(instances.Size());
+            m_faces[nIndex].clear();
+            m_origins[nIndex] = { x, y, z };
+
+            std::vector<InstanceSlotMap::Range> ranges;
+            instances.TakeDirtyRanges(&ranges);
+            for (const InstanceSlotMap::Range & r : ranges)
+            {
+                for (uint32_t i = r.begin; i < r.end; ++i)
+                {
+                    int cx, cy, cz, type;
+                    UnpackCubeInstance(instances.Data()[i], &cx, &cy, &cz, &type);
+                    v[i] = DirectX::XMFLOAT4(2.0f * (x + cx), 2.0f * (y + cy), 2.0f * (z + cz),
+                                             static_cast<float>(type));
+                }
+                m_nUploadBytes += (r.end - r.begin) * sizeof(CubeInstance);
+            }
+        }
+        void            UpdateFaceBuffer(size_t nIndex,
+                                         const FaceVertex * pVertices,
+                                         size_t nVertex,
+                                         int x, int y, int z)
+        {
+            m_faces.at(nIndex).assign(pVertices, pVertices + nVertex);
+            m_instances[nIndex].clear();
+            m_origins[nIndex]   = { x, y, z };
+            m_sources[nIndex]   = nullptr;
+            m_nUploadBytes      += nVertex * sizeof(FaceVertex);
+        }
+        void            ReleaseInstanceBuffer(size_t nIndex)
+        {
+            m_instances.at(nIndex).clear();
+            m_faces[nIndex].clear();
+            m_sources[nIndex] = nullptr;
+        }
+        void            MoveInstanceBuffer(size_t nFrom, size_t nTo)
+        {
+            m_instances.at(nTo) = std::move(m_instances.at(nFrom));
+            m_faces.at(nTo)     = std::move(m_faces.at(nFrom));
+            m_origins.at(nTo)   = m_origins.at(nFrom);
+            m_sources.at(nTo)   = m_sources.at(nFrom);
+            ReleaseInstanceBuffer(nFrom);
+        }
+
+        void            SetPoolSize(size_t nPoolSize)
+        {
+            m_instances.resize(nPoolSize);
+            m_faces.resize(nPoolSize);
+            m_origins.resize(nPoolSize);
+            m_sources.resize(nPoolSize, nullptr);
+        }
+        size_t          GetPoolSize() const { return m_instances.size(); }
+
+        // per slot, what the GPU would draw
+        std::vector<std::vector<DirectX::XMFLOAT4>> m_instances;
+        std::vector<std::vector<FaceVertex>>        m_faces;
+        std::vector<Origin>                         m_origins;
+
+        // map each slot was last fed by
+        std::vector<const InstanceSlotMap *>        m_sources;
+        size_t                                      m_nUploadBytes;
+    };
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+// MSVC's <intrin.h> for gcc and clang: the intrinsics and the cpuid and
+// xgetbv calls BitExpand uses. <cpuid.h> and <immintrin.h> already use
+// the MSVC names, hence the macros.
+
+#include <cpuid.h>
+#include <immintrin.h>
+
+inline void CpuidEx(int info[4], int leaf, int subleaf)
+{
+    __cpuid_count(leaf, subleaf, info[0], info[1], info[2], info[3]);
+}
+inline unsigned long long Xgetbv(unsigned int xcr)
+{
+    unsigned int eax, edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(xcr));
+    return (static_cast<unsigned long long>(edx) << 32) | eax;
+}
+
+#undef __cpuid
+#define __cpuid(info, leaf)             CpuidEx(info, leaf, 0)
+#define __cpuidex(info, leaf, subleaf)  CpuidEx(info, leaf, subleaf)
+#define _xgetbv(xcr)                    Xgetbv(xcr)
@@ -0,0 +1,122 @@
+//
+// pch.h
+// Stand-in for Source/pch.h in headless builds: what the block system
+// takes from the Windows SDK and ErrorHandling.h, without D3D.
+//
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#ifdef _WIN32
+
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include <DirectXMath.h>
+
+#else
+
+#include <map>
+#include <mutex>
+#include <sys/mman.h>
+
+#define UNREFERENCED_PARAMETER(x)   ((void)(x))
+
+typedef unsigned char   BYTE;
+typedef long            HRESULT;
+
+namespace DirectX
+{
+    struct XMFLOAT4
+    {
+        float x, y, z, w;
+
+        XMFLOAT4() = default;
+        XMFLOAT4(float _x, float _y, float _z, float _w) : x(_x), y(_y), z(_z), w(_w) {}
+    };
+}
+
+// SlabPool's virtual memory calls over mmap, no large pages.
+#define MEM_COMMIT          0x1000
+#define MEM_RESERVE         0x2000
+#define MEM_RELEASE         0x8000
+#define MEM_LARGE_PAGES     0x20000000
+#define PAGE_READWRITE      0x04
+
+struct MappedRegions
+{
+    std::mutex                  lock;
+    std::map<void *, size_t>    sizes;  // VirtualFree gets no size, munmap needs it
+
+    static MappedRegions & Get()
+    {
+        static MappedRegions regions;
+        return regions;
+    }
+};
+
+inline size_t GetLargePageMinimum()
+{
+    return 0;
+}
+inline void * VirtualAlloc(void * pAddress, size_t nSize, int nType, int nProtect)
+{
+    UNREFERENCED_PARAMETER(pAddress);
+    UNREFERENCED_PARAMETER(nProtect);
+    if (nType & MEM_LARGE_PAGES)
+        return nullptr;
+
+    void * p = mmap(nullptr, nSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED)
+        return nullptr;
+
+    MappedRegions & r = MappedRegions::Get();
+    std::lock_guard<std::mutex> lock(r.lock);
+    r.sizes[p] = nSize;
+    return p;
+}
+inline int VirtualFree(void * p, size_t nSize, int nType)
+{
+    UNREFERENCED_PARAMETER(nSize);
+    UNREFERENCED_PARAMETER(nType);
+
+    MappedRegions & r = MappedRegions::Get();
+    std::lock_guard<std::mutex> lock(r.lock);
+    auto it = r.sizes.find(p);
+    if (it == r.sizes.end())
+        return 0;
+    munmap(p, it->second);
+    r.sizes.erase(it);
+    return 1;
+}
+
+// The debugger output goes to stderr.
+inline void OutputDebugStringA(const char * s)
+{
+    std::fputs(s, stderr);
+}
+
+#endif
+
+namespace win32
+{
+    inline void ENSURE_TRUE(bool bRet)
+    {
+        if (!bRet)
+            throw std::runtime_error("ENSURE_TRUE failed");
+    }
+    inline void ENSURE_NOT_NULL(const void * pv)
+    {
+        if (!pv)
+            throw std::runtime_error("ENSURE_NOT_NULL failed");
+    }
+}